@@ -0,0 +1,165 @@
+#include "BatchPathSimulator2D.h"
+
+// Shifts and scales the values to a zero mean and a unit sample variance
+static void matchMoments(double* values, size_t n)
+{
+	if (n < 2)
+		return;
+	double mean = 0.;
+	for (size_t i = 0; i < n; ++i)
+		mean += values[i];
+	mean /= n;
+	double variance = 0.;
+	for (size_t i = 0; i < n; ++i)
+		variance += (values[i] - mean) * (values[i] - mean);
+	variance /= (n - 1);
+	double scale = (variance > 0.) ? 1. / sqrt(variance) : 1.;
+	for (size_t i = 0; i < n; ++i)
+		values[i] = (values[i] - mean) * scale;
+}
+
+BatchPathSimulator2D::BatchPathSimulator2D(const schema& schema, size_t number_of_paths) :
+	_schema(schema.clone()), _number_of_paths(number_of_paths), _first_path_index(0), _moment_matching(false),
+	_log_spots(number_of_paths), _variances(number_of_paths), _next_variances(number_of_paths),
+	_normals_variance(number_of_paths), _uniforms_variance(number_of_paths),
+	_normals_integrated(schema.samplesIntegratedVariance() ? number_of_paths : 0),
+	_uniforms_integrated(schema.samplesIntegratedVariance() ? number_of_paths : 0), _normals_spot(number_of_paths)
+{
+	reset(0);
+}
+
+BatchPathSimulator2D::BatchPathSimulator2D(const BatchPathSimulator2D& batch_simulator) :
+	_schema(batch_simulator._schema->clone()), _number_of_paths(batch_simulator._number_of_paths),
+	_first_path_index(batch_simulator._first_path_index), _moment_matching(batch_simulator._moment_matching),
+	_log_spots(batch_simulator._log_spots), _variances(batch_simulator._variances),
+	_next_variances(batch_simulator._next_variances), _normals_variance(batch_simulator._normals_variance),
+	_uniforms_variance(batch_simulator._uniforms_variance), _normals_integrated(batch_simulator._normals_integrated),
+	_uniforms_integrated(batch_simulator._uniforms_integrated), _normals_spot(batch_simulator._normals_spot)
+{
+}
+
+BatchPathSimulator2D& BatchPathSimulator2D::operator=(const BatchPathSimulator2D& batch_simulator)
+{
+	// check for "self assignment" and do nothing in that case
+	if (!(this == &batch_simulator)) {
+		delete _schema;
+		_schema = batch_simulator._schema->clone();
+
+		_number_of_paths = batch_simulator._number_of_paths;
+		_first_path_index = batch_simulator._first_path_index;
+		_moment_matching = batch_simulator._moment_matching;
+		_log_spots = batch_simulator._log_spots;
+		_variances = batch_simulator._variances;
+		_next_variances = batch_simulator._next_variances;
+		_normals_variance = batch_simulator._normals_variance;
+		_uniforms_variance = batch_simulator._uniforms_variance;
+		_normals_integrated = batch_simulator._normals_integrated;
+		_uniforms_integrated = batch_simulator._uniforms_integrated;
+		_normals_spot = batch_simulator._normals_spot;
+	}
+	return *this;
+}
+
+BatchPathSimulator2D::~BatchPathSimulator2D()
+{
+	delete _schema;
+}
+
+void BatchPathSimulator2D::setMomentMatching(bool moment_matching)
+{
+	_moment_matching = moment_matching;
+}
+
+void BatchPathSimulator2D::reset(size_t first_path_index)
+{
+	Pair initial_factors = _schema->getInitialFactors();
+	double initial_log_spot = log(initial_factors.first);
+
+	_first_path_index = first_path_index;
+	for (size_t i = 0; i < _number_of_paths; ++i) {
+		_log_spots[i] = initial_log_spot;
+		_variances[i] = initial_factors.second;
+	}
+}
+
+void BatchPathSimulator2D::fillDraws(int current_index, RandomEngine& engine, bool simulate_spot)
+{
+	bool sample_integrated = simulate_spot && _schema->samplesIntegratedVariance();
+	for (size_t i = 0; i < _number_of_paths; ++i) {
+		engine.skipTo(_first_path_index + i, current_index);
+		_normals_variance[i] = engine.normalRandom();
+		_uniforms_variance[i] = engine.uniformRandom();
+		// Same order as the single path version
+		if (simulate_spot)
+			_normals_spot[i] = engine.normalRandom();
+		if (sample_integrated) {
+			_normals_integrated[i] = engine.normalRandom();
+			_uniforms_integrated[i] = engine.uniformRandom();
+		}
+	}
+
+	// The uniforms are left as they are: an affine map could take them out of ]0, 1[
+	if (_moment_matching) {
+		matchMoments(_normals_variance.data(), _number_of_paths);
+		if (simulate_spot)
+			matchMoments(_normals_spot.data(), _number_of_paths);
+	}
+}
+
+void BatchPathSimulator2D::nextStep(int current_index, RandomEngine& engine)
+{
+	nextStep(current_index, engine, true);
+}
+
+void BatchPathSimulator2D::nextStep(int current_index, RandomEngine& engine, bool simulate_spot)
+{
+	fillDraws(current_index, engine, simulate_spot);
+
+	_schema->nextStepVolatilityBatch(current_index, _variances.data(), _normals_variance.data(),
+		_uniforms_variance.data(), _next_variances.data(), _number_of_paths);
+	if (simulate_spot)
+		_schema->nextStepLogSpotBatch(current_index, _variances.data(), _next_variances.data(),
+			_normals_integrated.data(), _uniforms_integrated.data(), _normals_spot.data(), _log_spots.data(), _number_of_paths);
+
+	_variances.swap(_next_variances);
+}
+
+void BatchPathSimulator2D::simulate(size_t first_path_index, RandomEngine& engine)
+{
+	reset(first_path_index);
+	const Vector& time_points = _schema->getTimePoints();
+	for (int index = 0; index < (int)time_points.size() - 1; ++index)
+		nextStep(index, engine);
+}
+
+void BatchPathSimulator2D::simulate(size_t first_path_index, RandomEngine& engine, PathAccumulator& accumulator)
+{
+	reset(first_path_index);
+	accumulator.resetBatch(_number_of_paths, _schema->getInitialFactors());
+	bool simulate_spot = accumulator.needsSpot();
+	const Vector& time_points = _schema->getTimePoints();
+	for (int index = 0; index < (int)time_points.size() - 1; ++index) {
+		nextStep(index, engine, simulate_spot);
+		accumulator.accumulateBatch(index + 1, simulate_spot ? _log_spots.data() : nullptr, _variances.data());
+	}
+}
+
+size_t BatchPathSimulator2D::getNumberOfPaths() const
+{
+	return _number_of_paths;
+}
+
+const Vector& BatchPathSimulator2D::getLogSpots() const
+{
+	return _log_spots;
+}
+
+const Vector& BatchPathSimulator2D::getVariances() const
+{
+	return _variances;
+}
+
+const schema* BatchPathSimulator2D::getSchema() const
+{
+	return _schema;
+}
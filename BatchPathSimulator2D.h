@@ -0,0 +1,67 @@
+#ifndef BATCHPATHSIMULATOR2D_H
+#define BATCHPATHSIMULATOR2D_H
+
+#ifndef SCHEMA_H
+#include "Schema.h"
+#endif
+
+#include "RandomEngine.h"
+#include "PathAccumulator.h"
+
+#include <vector>
+
+using Vector = std::vector<double>;
+
+// Simulates a batch of paths together, one time step after the other.
+// The paths are stored as arrays (one for the log spots, one for the variances), so the schema kernels run over contiguous memory.
+// Path i of the batch draws from the (first_path_index + i) substream of the engine: at each step a normal for the variance,
+// a uniform for the variance, a normal and a uniform for the integrated variance if the schema samples it, and a normal for the spot.
+// With moment matching, the normals of each step are shifted and scaled over the batch to have exactly a zero mean and
+// a unit variance: the paths of a batch are then no longer independent, only the batches are.
+class BatchPathSimulator2D final
+{
+public:
+	BatchPathSimulator2D(const schema& schema, size_t number_of_paths);
+	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
+	BatchPathSimulator2D(const BatchPathSimulator2D& batch_simulator);
+	BatchPathSimulator2D& operator=(const BatchPathSimulator2D& batch_simulator);
+	~BatchPathSimulator2D();
+
+	void setMomentMatching(bool moment_matching);
+
+	// Puts every path of the batch back at the initial factors
+	void reset(size_t first_path_index);
+	// Advances every path of the batch from time point current_index to current_index + 1
+	void nextStep(int current_index, RandomEngine& engine);
+	// Reset and advance until the last time point
+	void simulate(size_t first_path_index, RandomEngine& engine);
+	// Same, giving the factors of every step to the accumulator (only the variances if it does not need the spot)
+	void simulate(size_t first_path_index, RandomEngine& engine, PathAccumulator& accumulator);
+
+	size_t getNumberOfPaths() const;
+	const Vector& getLogSpots() const;
+	const Vector& getVariances() const;
+	const schema* getSchema() const;
+
+private:
+	void fillDraws(int current_index, RandomEngine& engine, bool simulate_spot);
+	void nextStep(int current_index, RandomEngine& engine, bool simulate_spot);
+
+	schema* _schema;
+	size_t _number_of_paths;
+	size_t _first_path_index;
+	bool _moment_matching;
+
+	Vector _log_spots;
+	Vector _variances;
+	Vector _next_variances;
+
+	// Draws of the current step, one per path
+	Vector _normals_variance;
+	Vector _uniforms_variance;
+	Vector _normals_integrated;
+	Vector _uniforms_integrated;
+	Vector _normals_spot;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "BatchPricer.h"
+#include "FunctionFairPrice.h"
+#include "MonteCarloPricer2D.h"
+#include "Schema.h"
+#include "WorkStealingPool.h"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+// Same as the demo schemas
+static const double PSI_C = 1.5;
+
+bool haveSamePaths(const Trade& trade, const Trade& other_trade)
+{
+	return trade.underlying == other_trade.underlying && trade.spot == other_trade.spot
+		&& trade.initial_variance == other_trade.initial_variance && trade.mean_reversion_speed == other_trade.mean_reversion_speed
+		&& trade.mean_reversion_level == other_trade.mean_reversion_level && trade.vol_of_vol == other_trade.vol_of_vol
+		&& trade.correlation == other_trade.correlation && trade.rate == other_trade.rate
+		&& trade.maturity == other_trade.maturity && trade.number_of_dates == other_trade.number_of_dates;
+}
+
+bool TradeGroupLess::operator()(const Trade& trade, const Trade& other_trade) const
+{
+	return std::tie(trade.underlying, trade.spot, trade.initial_variance, trade.mean_reversion_speed, trade.mean_reversion_level,
+		trade.vol_of_vol, trade.correlation, trade.rate, trade.maturity, trade.number_of_dates)
+		< std::tie(other_trade.underlying, other_trade.spot, other_trade.initial_variance, other_trade.mean_reversion_speed,
+			other_trade.mean_reversion_level, other_trade.vol_of_vol, other_trade.correlation, other_trade.rate,
+			other_trade.maturity, other_trade.number_of_dates);
+}
+
+static Vector createTradeTimePoints(const Trade& trade)
+{
+	Vector time_points(trade.number_of_dates + 1);
+	for (size_t time_index = 0; time_index < time_points.size(); ++time_index)
+		time_points[time_index] = trade.maturity * (double)time_index / (double)trade.number_of_dates;
+	return time_points;
+}
+
+static HestonModel createTradeModel(const Trade& trade)
+{
+	return HestonModel(trade.correlation, trade.rate, trade.mean_reversion_speed, trade.mean_reversion_level, trade.vol_of_vol);
+}
+
+// The schema is only needed to build the path simulator and the fair strike
+static schemaQE createTradeSchema(const Trade& trade)
+{
+	return schemaQE(Pair(trade.spot, trade.initial_variance), createTradeTimePoints(trade), PSI_C, createTradeModel(trade));
+}
+
+TradeGroupModel::TradeGroupModel(const Trade& trade) :
+	_path_simulator(Pair(trade.spot, trade.initial_variance), createTradeTimePoints(trade), createTradeModel(trade), createTradeSchema(trade)),
+	_fair_strike(FairPriceFunction(trade.rate, *_path_simulator.getSchema()).getFairPrice())
+{
+}
+
+const PathSimulator2D& TradeGroupModel::getPathSimulator() const
+{
+	return _path_simulator;
+}
+
+double TradeGroupModel::getFairStrike() const
+{
+	return _fair_strike;
+}
+
+static MonteCarloPricer2D* createContractPricer(const Trade& trade, const PathSimulator2D& path_simulator, size_t number_of_simulations)
+{
+	switch (trade.contract)
+	{
+	case ContractType::VolatilitySwap:
+		return new MonteCarloVolatilitySwapPricer2D(path_simulator, number_of_simulations, trade.rate, trade.strike, trade.is_call);
+	case ContractType::CappedVarianceSwap:
+		return new MonteCarloCappedVarianceSwapPricer2D(path_simulator, number_of_simulations, trade.rate, trade.strike, trade.is_call,
+			trade.parameter1);
+	case ContractType::CorridorVarianceSwap:
+		return new MonteCarloCorridorVarianceSwapPricer2D(path_simulator, number_of_simulations, trade.rate, trade.strike, trade.is_call,
+			trade.parameter1, trade.parameter2);
+	default:
+		return new MonteCarloVarianceSwapPricer2D(path_simulator, number_of_simulations, trade.rate, trade.strike, trade.is_call);
+	}
+}
+
+std::vector<TradeResult> priceTradeGroup(const TradeGroupModel& model, const std::vector<Trade>& trades, size_t number_of_simulations,
+	unsigned long long seed)
+{
+	const PathSimulator2D& path_simulator = model.getPathSimulator();
+	MonteCarloPortfolioPricer2D portfolio(path_simulator, number_of_simulations);
+	for (const Trade& trade : trades)
+	{
+		MonteCarloPricer2D* contract = createContractPricer(trade, path_simulator, number_of_simulations);
+		portfolio.addContract(*contract);
+		delete contract;
+	}
+	std::vector<ContractPrice> prices = portfolio.priceContracts(1, seed);
+
+	std::vector<TradeResult> results(trades.size());
+	for (size_t trade_index = 0; trade_index < trades.size(); ++trade_index)
+		results[trade_index] = { trades[trade_index].id, prices[trade_index].price, prices[trade_index].standard_error, model.getFairStrike() };
+	return results;
+}
+
+std::vector<TradeResult> priceTradeGroup(const std::vector<Trade>& trades, size_t number_of_simulations, unsigned long long seed)
+{
+	if (trades.empty())
+		return std::vector<TradeResult>();
+	return priceTradeGroup(TradeGroupModel(trades[0]), trades, number_of_simulations, seed);
+}
+
+BatchPricer::BatchPricer(const BatchPricingSettings& settings) :
+	_settings(settings)
+{
+}
+
+size_t BatchPricer::run(TradeReader& reader, std::ostream& output) const
+{
+	std::mutex output_mutex;
+	output << "id,price,standard_error,fair_strike\n";
+	output.precision(10);
+
+	WorkStealingPool pool(_settings.number_of_threads);
+	unsigned long long group_index = 0;
+	auto submitGroup = [&](std::vector<Trade>& trades) {
+		unsigned long long seed = _settings.seed + group_index++;
+		size_t number_of_simulations = _settings.number_of_simulations;
+		// The trades are moved to the task, the group starts empty again
+		pool.submit([&output, &output_mutex, number_of_simulations, seed, trades = std::move(trades)]() {
+			std::vector<TradeResult> results;
+			std::string error;
+			try {
+				results = priceTradeGroup(trades, number_of_simulations, seed);
+			}
+			catch (const std::exception& exception) {
+				error = exception.what();
+			}
+			std::lock_guard<std::mutex> lock(output_mutex);
+			if (results.size() == trades.size()) {
+				for (const TradeResult& result : results)
+					output << result.id << "," << result.price << "," << result.standard_error << "," << result.fair_strike << "\n";
+			}
+			else {
+				std::cerr << "Group of " << trades.size() << " trades on " << trades[0].underlying << " failed: " << error << "\n";
+				for (const Trade& trade : trades)
+					output << trade.id << ",error\n";
+			}
+			output.flush();
+		});
+		trades.clear();
+	};
+
+	std::map<Trade, std::vector<Trade>, TradeGroupLess> groups;
+	size_t number_of_trades = 0;
+	size_t buffered_trades = 0;
+	Trade trade;
+	while (reader.next(trade))
+	{
+		++number_of_trades;
+		std::vector<Trade>& group = groups[trade];
+		group.push_back(trade);
+		++buffered_trades;
+		if (group.size() >= _settings.maximum_group_size) {
+			buffered_trades -= group.size();
+			submitGroup(group);
+			groups.erase(trade);
+		}
+		else if (buffered_trades >= _settings.maximum_buffered_trades) {
+			// Too many underlyings at once: every open group is priced as it is
+			for (auto& key_and_group : groups)
+				submitGroup(key_and_group.second);
+			groups.clear();
+			buffered_trades = 0;
+		}
+	}
+	for (auto& key_and_group : groups)
+		submitGroup(key_and_group.second);
+
+	pool.wait();
+	return number_of_trades;
+}
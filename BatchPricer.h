@@ -0,0 +1,80 @@
+#ifndef BATCHPRICER_H
+#define BATCHPRICER_H
+
+#include "PathSimulator2D.h"
+#include "TradeFile.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Price of one trade: Monte Carlo price and standard error of its contract, and the fair strike of the variance swap
+// on the same underlying and schedule
+struct TradeResult
+{
+	uint64_t id;
+	double price;
+	double standard_error;
+	double fair_strike;
+};
+
+struct BatchPricingSettings
+{
+	size_t number_of_simulations;
+	unsigned long long seed;
+	size_t number_of_threads;			// 0 means one per core
+	size_t maximum_group_size;			// trades priced together on the same paths
+	size_t maximum_buffered_trades;		// trades read but not yet submitted to the workers
+};
+
+// True if the two trades have the same underlying, market parameters and schedule: they can be priced on the same paths
+bool haveSamePaths(const Trade& trade, const Trade& other_trade);
+
+// Order of the groups of trades, consistent with haveSamePaths (key of a std::map)
+struct TradeGroupLess
+{
+	bool operator()(const Trade& trade, const Trade& other_trade) const;
+};
+
+// What the trades with the same paths as a trade share: the path simulator (QE schema, drift of the model = rate,
+// number_of_dates equally spaced dates up to the maturity) and the fair strike of the variance swap.
+// It never changes once built, so it can be kept and shared between threads (the pricing server caches them).
+class TradeGroupModel final
+{
+public:
+	TradeGroupModel(const Trade& trade);
+
+	const PathSimulator2D& getPathSimulator() const;
+	double getFairStrike() const;
+
+private:
+	PathSimulator2D _path_simulator;
+	double _fair_strike;
+};
+
+// Prices trades that all have the same paths (see haveSamePaths) in one portfolio, on one thread: each path is simulated once
+// for all of them. The paths are those of a PhiloxEngine with the given seed, so the price of a trade does not depend on
+// the other trades of the group.
+std::vector<TradeResult> priceTradeGroup(const TradeGroupModel& model, const std::vector<Trade>& trades, size_t number_of_simulations,
+	unsigned long long seed);
+// Same, the model of the group being built from the first trade
+std::vector<TradeResult> priceTradeGroup(const std::vector<Trade>& trades, size_t number_of_simulations, unsigned long long seed);
+
+// Prices the trades of a file, without loading it: the trades read are grouped by underlying (haveSamePaths), and a group is
+// given to a WorkStealingPool once full, or when too many trades are buffered. Each result is written as soon as its group
+// is priced, in the CSV format id,price,standard_error,fair_strike, so the order of the output is not that of the input.
+// If the pricing of a group fails, each of its trades gets the line id,error.
+// The paths of the k-th group formed use the seed settings.seed + k: the results do not depend on the number of threads.
+class BatchPricer final
+{
+public:
+	BatchPricer(const BatchPricingSettings& settings);
+
+	// Number of trades priced
+	size_t run(TradeReader& reader, std::ostream& output) const;
+
+private:
+	BatchPricingSettings _settings;
+};
+
+#endif
@@ -1,17 +1,49 @@
 #include "FunctionFairPrice.h"
+#include <algorithm>
 
-FairPriceFunction::FairPriceFunction(double h, double rate, schema& schema)
+// Number of parameter sets evaluated together by getFairPricesBatch
+static const size_t FAIR_PRICE_LANES = 4;
+
+// FAIR_PRICE_LANES values operated on element by element: the loops have a fixed length, so the compiler can vectorize them
+struct FairPriceLanes
+{
+	double lane[FAIR_PRICE_LANES];
+
+	FairPriceLanes() {}
+	FairPriceLanes(double constant) { for (size_t k = 0; k < FAIR_PRICE_LANES; ++k) lane[k] = constant; }
+};
+
+#define FAIR_PRICE_LANES_OPERATOR(op) \
+	inline FairPriceLanes operator op(const FairPriceLanes& u, const FairPriceLanes& v) \
+	{ FairPriceLanes w; for (size_t k = 0; k < FAIR_PRICE_LANES; ++k) w.lane[k] = u.lane[k] op v.lane[k]; return w; } \
+	inline FairPriceLanes operator op(double u, const FairPriceLanes& v) { return FairPriceLanes(u) op v; }
+FAIR_PRICE_LANES_OPERATOR(+)
+FAIR_PRICE_LANES_OPERATOR(-)
+FAIR_PRICE_LANES_OPERATOR(*)
+FAIR_PRICE_LANES_OPERATOR(/)
+#undef FAIR_PRICE_LANES_OPERATOR
+
+inline FairPriceLanes operator-(const FairPriceLanes& u) { return 0. - u; }
+
+#define FAIR_PRICE_LANES_FUNCTION(function) \
+	inline FairPriceLanes function(const FairPriceLanes& u) \
+	{ FairPriceLanes w; for (size_t k = 0; k < FAIR_PRICE_LANES; ++k) w.lane[k] = std::function(u.lane[k]); return w; }
+FAIR_PRICE_LANES_FUNCTION(exp)
+FAIR_PRICE_LANES_FUNCTION(log)
+FAIR_PRICE_LANES_FUNCTION(sqrt)
+#undef FAIR_PRICE_LANES_FUNCTION
+
+FairPriceFunction::FairPriceFunction(double rate, const schema& schema)
 {
 	_schema = schema.clone();
-	_h = h;
 	_rate = rate;
 }
 
 FairPriceFunction::FairPriceFunction(const FairPriceFunction& fair_price_function)
 {
 	_schema = fair_price_function._schema->clone();
-	_h = fair_price_function._h;
 	_rate = fair_price_function._rate;
+	_terms = fair_price_function._terms;
 }
 
 FairPriceFunction& FairPriceFunction::operator=(const FairPriceFunction& fair_price_function)
@@ -20,8 +52,8 @@ FairPriceFunction& FairPriceFunction::operator=(const FairPriceFunction& fair_pr
 	if (!(this == &fair_price_function)) {
 		delete _schema;
 		_schema = fair_price_function._schema->clone();
-		_h = fair_price_function._h;
 		_rate = fair_price_function._rate;
+		_terms = fair_price_function._terms;
 	}
 	return *this;
 }
@@ -31,90 +63,132 @@ FairPriceFunction::~FairPriceFunction()
 	delete _schema;
 }
 
-std::complex<double> FairPriceFunction::CFunction(double tau, double omega)
+const FairPriceFunction::CharacteristicTerms& FairPriceFunction::getTerms(double delta)
 {
+	auto found = _terms.find(delta);
+	if (found != _terms.end())
+		return found->second;
+
 	const Model2D* model = _schema->getModel();
-	std::complex<double> a = model->get_mean_reversion_speed() - model->get_correlation() * model->get_vol_of_vol() * 1.0i * omega;
-	std::complex<double> b = sqrt(a * a + model->get_vol_of_vol() * model->get_vol_of_vol() * (1.0i * omega + omega * omega));
-	std::complex<double> g = (a - b) / (a + b);
-	return (model->get_drift() * 1.0i * omega - _rate) * tau + model->get_mean_reversion_speed() * model->get_mean_reversion_level()
-		/ (model->get_vol_of_vol() * model->get_vol_of_vol()) * ((a - b) * tau - 2. * log((1. - g * exp(-b * tau)) / (1. - g)));
-}
+	double CPrime, CPrimePrime, DPrime, DPrimePrime;
+	characteristicDerivatives(model->get_mean_reversion_speed(), model->get_mean_reversion_level(), model->get_vol_of_vol(),
+		model->get_correlation(), model->get_drift(), delta, CPrime, CPrimePrime, DPrime, DPrimePrime);
 
-std::complex<double> FairPriceFunction::CFunctionPrime(double tau, double omega)
-{
-	return (CFunction(tau, omega + _h) - CFunction(tau, omega)) / _h;
+	// From the derivatives in x = i * omega to the derivatives in omega
+	CharacteristicTerms terms;
+	terms.CPrime = 1.0i * CPrime;
+	terms.CPrimePrime = -CPrimePrime;
+	terms.DPrime = 1.0i * DPrime;
+	terms.DPrimePrime = -DPrimePrime;
+	return _terms[delta] = terms;
 }
 
-std::complex<double> FairPriceFunction::CFunctionPrimePrime(double tau, double omega)
+// This function needs the step t_i - t_(i-1), so it's implicit and we had to add it for completeness
+// It is the second moment of the log return when the variance at t_(i-1) is known and equal to tau: minus the second derivative of
+// the characteristic function at 0.
+double FairPriceFunction::GFunction(double tau, double delta)
 {
-	return (CFunction(tau, omega + _h) - 2. * CFunction(tau, omega) + CFunction(tau, omega - _h)) / (_h * _h);
+	const CharacteristicTerms& terms = getTerms(delta);
+	std::complex<double> firstPart = terms.DPrime * terms.DPrime * tau * tau;
+	std::complex<double> secondPart = (2. * terms.CPrime * terms.DPrime + terms.DPrimePrime) * tau;
+	std::complex<double> thirdPart = terms.CPrime * terms.CPrime + terms.CPrimePrime;
+	return -(firstPart + secondPart + thirdPart).real();
 }
 
-std::complex<double> FairPriceFunction::DFunction(double tau, double omega)
+// The variance at start is known only for the first step: after that it is averaged against its non central chi square law
+double FairPriceFunction::getStepExpectation(double start, double delta)
 {
 	const Model2D* model = _schema->getModel();
-	std::complex<double> a = model->get_mean_reversion_speed() - model->get_correlation() * model->get_vol_of_vol() * 1.0i * omega;
-	std::complex<double> b = sqrt(a * a + model->get_vol_of_vol() * model->get_vol_of_vol() * (1.0i * omega + omega * omega));
-	std::complex<double> g = (a - b) / (a + b);
-	return (a - b) / (model->get_vol_of_vol() * model->get_vol_of_vol()) * ((1. - exp(-b * tau)) / (1. - g * exp(-b * tau)));
-}
-
-std::complex<double> FairPriceFunction::DFunctionPrime(double tau, double omega)
-{
-	return (DFunction(tau, omega + _h) - DFunction(tau, omega)) / _h;
-}
-
-std::complex<double> FairPriceFunction::DFunctionPrimePrime(double tau, double omega)
-{
-	return (DFunction(tau, omega + _h) - 2. * DFunction(tau, omega) + DFunction(tau, omega - _h)) / (_h * _h);
-}
+	double v0 = _schema->getInitialFactors().second;
+	if (start <= _schema->getTimePoints()[0]) return GFunction(v0, delta);
 
-// We added the index parameter, because this function needs t_i and t_(i-1), so it's implicit and we had to add it for completeness
-double FairPriceFunction::GFunction(double tau, int index)
-{
-	if (index == 0) return 0;
-	double delta = _schema->getTimePoints()[index] - _schema->getTimePoints()[index - 1];
-	std::complex<double> firstPart = DFunctionPrime(delta, 0.) * DFunctionPrime(delta, 0.) * tau * tau;
-	std::complex<double> secondPart = (2. * CFunctionPrime(delta, 0.) * DFunctionPrime(delta, 0.) + DFunctionPrimePrime(delta, 0.)) * tau;
-	std::complex<double> thirdPart = CFunctionPrime(delta, 0.) * CFunctionPrime(delta, 0.) + CFunctionPrimePrime(delta, 0.);
-	return (firstPart + secondPart + thirdPart).real();
+	const CharacteristicTerms& terms = getTerms(delta);
+	std::complex<double> qTilde = 2. * model->get_mean_reversion_speed() * model->get_mean_reversion_level()
+		/ (model->get_vol_of_vol() * model->get_vol_of_vol());
+	std::complex<double> ci = 2. * model->get_mean_reversion_speed() / (model->get_vol_of_vol() * model->get_vol_of_vol()
+		* (1. - exp(-model->get_mean_reversion_speed() * start)));
+	std::complex<double> Wi = ci * v0 * exp(-model->get_mean_reversion_speed() * start);
+	std::complex<double> price = -terms.DPrime * terms.DPrime
+		* (qTilde + 2. * Wi + (qTilde + Wi) * (qTilde + Wi)) / (ci * ci)
+		- (2. * terms.CPrime * terms.DPrime
+			+ terms.DPrimePrime) * (qTilde + Wi) / ci
+		- (terms.CPrime * terms.CPrime
+			+ terms.CPrimePrime);
+	return price.real();
 }
 
 // Function to compute the expectation of the log return at each step, to make sure the computation is right at each step
 double FairPriceFunction::getFairPriceIndex(int index) {
-	const Model2D* model = _schema->getModel();
-	double s0 = _schema->getInitialFactors().first;
-	double v0 = _schema->getInitialFactors().second;
-	Vector timePoints = _schema->getTimePoints();
+	const Vector& timePoints = _schema->getTimePoints();
 	if (index < 1) return 0.;
-	else if (index == 1) return GFunction(v0, 1);
-	else {
-		double T_I = timePoints[index];
-		double T_IMinusOne = timePoints[index - 1];
-		double delta = T_I - T_IMinusOne;
-		std::complex<double> qTilde = 2. * model->get_mean_reversion_speed() * model->get_mean_reversion_level()
-			/ (model->get_vol_of_vol() * model->get_vol_of_vol());
-		std::complex<double> ci = 2. * model->get_mean_reversion_speed() / (model->get_vol_of_vol() * model->get_vol_of_vol()
-			* (1. - exp(-model->get_mean_reversion_speed() * T_IMinusOne)));
-		std::complex<double> Wi = ci * v0 * exp(-model->get_mean_reversion_speed() * T_IMinusOne);
-		std::complex<double> price = -DFunctionPrime(delta, 0.) * DFunctionPrime(delta, 0.)
-			* (qTilde + 2. * Wi + (qTilde + Wi) * (qTilde + Wi)) / (ci * ci)
-			- (2. * CFunctionPrime(delta, 0.) * DFunctionPrime(delta, 0.)
-				+ DFunctionPrimePrime(delta, 0.)) * (qTilde + Wi) / ci
-			- (CFunctionPrime(delta, 0.) * CFunctionPrime(delta, 0.)
-				+ CFunctionPrimePrime(delta, 0.));
-		return price.real();
-	}
+	return getStepExpectation(timePoints[index - 1], timePoints[index] - timePoints[index - 1]);
 }
 
 // Final function to calculate the fair price
 double FairPriceFunction::getFairPrice()
 {
-	Vector timePoints = _schema->getTimePoints();
+	const Vector& timePoints = _schema->getTimePoints();
 	double strikeCalc = 0;
 	for (int i = 0; i < timePoints.size(); i++) {
 		strikeCalc += getFairPriceIndex(i);
 	}
 	return strikeCalc / timePoints[timePoints.size() - 1];
 }
+
+// Running sum of the step expectations: the fair strike of maturity t_i is the sum up to i divided by t_i
+Vector FairPriceFunction::getFairPriceTermStructure()
+{
+	const Vector& timePoints = _schema->getTimePoints();
+	Vector strikes(timePoints.size(), 0.);
+	double strikeCalc = 0;
+	for (int i = 1; i < timePoints.size(); i++) {
+		strikeCalc += getFairPriceIndex(i);
+		strikes[i] = strikeCalc / timePoints[i];
+	}
+	return strikes;
+}
+
+// Same running sum, stopped at each maturity: the last step of a maturity between two dates of the schedule is shorter
+Vector FairPriceFunction::getFairPrices(const Vector& maturities)
+{
+	const Vector& timePoints = _schema->getTimePoints();
+	Vector strikes(maturities.size(), 0.);
+	double strikeCalc = 0;
+	int i = 1;
+	for (size_t maturity_index = 0; maturity_index < maturities.size(); ++maturity_index) {
+		double maturity = maturities[maturity_index];
+		while (i < timePoints.size() && timePoints[i] <= maturity) {
+			strikeCalc += getFairPriceIndex(i);
+			i++;
+		}
+		double lastDate = timePoints[i - 1];
+		double lastStep = (maturity > lastDate ? getStepExpectation(lastDate, maturity - lastDate) : 0.);
+		strikes[maturity_index] = (strikeCalc + lastStep) / maturity;
+	}
+	return strikes;
+}
+
+void getFairPricesBatch(const HestonParameterBatch& parameters, const Vector& time_points, double* fair_prices)
+{
+	Vector maturity(1, time_points[time_points.size() - 1]);
+	for (size_t first = 0; first < parameters.size; first += FAIR_PRICE_LANES)
+	{
+		// The last lanes of an incomplete group repeat the last parameter set
+		FairPriceLanes kappa, theta, sigma, rho, drift, v0;
+		for (size_t k = 0; k < FAIR_PRICE_LANES; ++k)
+		{
+			size_t index = std::min(first + k, parameters.size - 1);
+			kappa.lane[k] = parameters.mean_reversion_speed[index];
+			theta.lane[k] = parameters.mean_reversion_level[index];
+			sigma.lane[k] = parameters.vol_of_vol[index];
+			rho.lane[k] = parameters.correlation[index];
+			drift.lane[k] = parameters.drift[index];
+			v0.lane[k] = parameters.initial_variance[index];
+		}
+
+		FairPriceLanes strike;
+		fairPriceTermStructure(kappa, theta, sigma, rho, drift, v0, time_points, maturity, &strike);
+		for (size_t k = 0; k < FAIR_PRICE_LANES && first + k < parameters.size; ++k)
+			fair_prices[first + k] = strike.lane[k];
+	}
+}
@@ -3,34 +3,151 @@
 #include <complex>
 #include <stdlib.h>
 #include <cmath>
+#include <map>
 #include "Schema.h"
+#include "TaylorJet.h"
 
 using namespace std::complex_literals;
 
+// Derivatives at x = 0 of the functions C(delta, x) and D(delta, x) of the Heston model, where C + D * v is the log of the
+// moment generating function E[exp(x * log return)] over a step delta, the current variance being v.
+// With x = i * omega, this is the characteristic function of the log return, so C'(omega) = i * dC/dx and C''(omega) = -d2C/dx2.
+// The derivatives are exact: the functions are evaluated on jets (forward mode automatic differentiation).
+template <class T>
+void characteristicDerivatives(const T& kappa, const T& theta, const T& sigma, const T& rho, const T& drift, double delta,
+	T& CPrime, T& CPrimePrime, T& DPrime, T& DPrimePrime)
+{
+	using J = Jet<T>;
+	J one = J(T(1.));
+	J tau = J(T(delta));
+	J x = J::variable(T(0.));
+
+	J a = J(kappa) - J(rho * sigma) * x;
+	J b = sqrt(a * a + J(sigma * sigma) * (x - x * x));
+	J g = (a - b) / (a + b);
+	J exponential = exp(-b * tau);
+
+	// The discount term of C is constant in x, so it is left out
+	J C = J(drift) * x * tau + J(kappa * theta / (sigma * sigma))
+		* ((a - b) * tau - J(T(2.)) * log((one - g * exponential) / (one - g)));
+	J D = (a - b) / J(sigma * sigma) * ((one - exponential) / (one - g * exponential));
+
+	CPrime = C.first;
+	CPrimePrime = C.second;
+	DPrime = D.first;
+	DPrimePrime = D.second;
+}
+
+// Fair strikes for increasing maturities in (t_0, t_N], as FairPriceFunction::getFairPrices, for one parameter set.
+// The derivatives in x = i * omega are real at x = 0, so everything is real: the expectation of the squared log return of a step
+// is C'' + C'^2 + (D'' + 2 C' D') E[v] + D'^2 E[v^2], with the mean and variance of the CIR variance at the start of the step.
+// T is double, or a type evaluating several parameter sets at once, or a Dual for the derivatives in the parameters.
+template <class T>
+void fairPriceTermStructure(const T& kappa, const T& theta, const T& sigma, const T& rho, const T& drift, const T& v0,
+	const Vector& time_points, const Vector& maturities, T* fair_prices)
+{
+	using std::exp;
+	T CPrime = T(0.), CPrimePrime = T(0.), DPrime = T(0.), DPrimePrime = T(0.), step_decay = T(0.);
+	// Coefficients of 1, E[v] and E[v^2] in the expectation of a step
+	T constant_term = T(0.), mean_term = T(0.), second_moment_term = T(0.);
+	T variance_scale = sigma * sigma / kappa;
+	// The derivatives only depend on the step: they are recomputed when it changes by more than the rounding of the dates
+	double previous_delta = -1.;
+	auto setStep = [&](double delta) {
+		if (std::abs(delta - previous_delta) <= 1e-12 * delta) return;
+		characteristicDerivatives(kappa, theta, sigma, rho, drift, delta, CPrime, CPrimePrime, DPrime, DPrimePrime);
+		step_decay = exp(-kappa * T(delta));
+		constant_term = CPrimePrime + CPrime * CPrime;
+		mean_term = DPrimePrime + 2. * CPrime * DPrime;
+		second_moment_term = DPrime * DPrime;
+		previous_delta = delta;
+	};
+	// exp(-kappa * t) at the start of the step, updated step by step
+	T decay = exp(-kappa * T(time_points[0]));
+	// The variance is known at the start of the first step
+	auto stepExpectation = [&](bool first_step) {
+		if (first_step)
+			return constant_term + mean_term * v0 + second_moment_term * v0 * v0;
+		T variance = variance_scale * (1. - decay) * (v0 * decay + 0.5 * theta * (1. - decay));
+		T mean = theta + (v0 - theta) * decay;
+		return constant_term + mean_term * mean + second_moment_term * (variance + mean * mean);
+	};
+
+	T strike = T(0.);
+	size_t i = 1;
+	for (size_t maturity_index = 0; maturity_index < maturities.size(); ++maturity_index) {
+		double maturity = maturities[maturity_index];
+		while (i < time_points.size() && time_points[i] <= maturity) {
+			setStep(time_points[i] - time_points[i - 1]);
+			strike = strike + stepExpectation(i == 1);
+			decay = decay * step_decay;
+			i++;
+		}
+		// Shorter last step of a maturity between two dates
+		T last_step = T(0.);
+		double last_date = time_points[i - 1];
+		if (maturity > last_date) {
+			setStep(maturity - last_date);
+			last_step = stepExpectation(i == 1);
+		}
+		fair_prices[maturity_index] = (strike + last_step) / T(maturity);
+	}
+}
+
+// Heston parameter sets of a batch, as structure of arrays: the i-th set is made of the i-th element of every array
+struct HestonParameterBatch
+{
+	size_t size;
+	const double* correlation;
+	const double* drift;
+	const double* mean_reversion_speed;
+	const double* mean_reversion_level;
+	const double* vol_of_vol;
+	const double* initial_variance;
+};
+
+// Fair strikes of the variance swap observing the time points, for every parameter set of the batch (fair_prices has parameters.size elements).
+// Same value as FairPriceFunction::getFairPrice, but the parameter sets are evaluated several at a time, in real arithmetic
+// and without any allocation per parameter set.
+void getFairPricesBatch(const HestonParameterBatch& parameters, const Vector& time_points, double* fair_prices);
+
 class FairPriceFunction
 {
 public:
-	FairPriceFunction(double h, double rate, schema& schema);
+	FairPriceFunction(double rate, const schema& schema);
 	// Pointer in member variable, so copy, assignment and destructor needed
 	FairPriceFunction(const FairPriceFunction& fair_price_function);
 	FairPriceFunction& operator=(const FairPriceFunction& fair_price_function);
 	~FairPriceFunction();
 
 	double getFairPrice();
+	// Fair strike for every maturity t_i of the schedule (the contract observing t_0, ..., t_i), in one pass over the schedule.
+	// The first entry, with no return observed, is 0.
+	Vector getFairPriceTermStructure();
+	// Fair strikes for increasing maturities in (t_0, t_N]: the contract observes the dates of the schedule before the maturity,
+	// and the maturity itself. One pass over the schedule and the maturities.
+	Vector getFairPrices(const Vector& maturities);
 private:
 
-	double _h;
+	// Derivatives in omega at omega = 0 of the functions C and D of the characteristic function
+	struct CharacteristicTerms
+	{
+		std::complex<double> CPrime;
+		std::complex<double> CPrimePrime;
+		std::complex<double> DPrime;
+		std::complex<double> DPrimePrime;
+	};
+
 	double _rate;
 	const schema* _schema;
+	// The terms only depend on the time step: they are computed once for each distinct step
+	std::map<double, CharacteristicTerms> _terms;
 
-	std::complex<double> CFunction(double tau, double omega);
-	std::complex<double> CFunctionPrime(double tau, double omega);
-	std::complex<double> CFunctionPrimePrime(double tau, double omega);
-	std::complex<double> DFunction(double tau, double omega);
-	std::complex<double> DFunctionPrime(double tau, double omega);
-	std::complex<double> DFunctionPrimePrime(double tau, double omega);
-	double GFunction(double tau, int index);
+	const CharacteristicTerms& getTerms(double delta);
+	double GFunction(double tau, double delta);
 
 	double getFairPriceIndex(int index);
+	// Expectation of the squared log return between start and start + delta
+	double getStepExpectation(double start, double delta);
 
-};
\ No newline at end of file
+};
@@ -1,7 +1,6 @@
 #include <iostream>
 
 #include "GridFunction.h"
-#include "brent.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -17,26 +16,24 @@ double normalCDF(double x) {
 
 
 gridFunction::gridFunction(Pair interval, int number_points):
-	_interval(interval), _number_points(number_points)
+	_interval(interval), _number_points(number_points), _status(RootSolverStatus::SUCCESS)
 {
 }
 
 Vector_Pair gridFunction::getGridFunctionR()
 {
-	Vector_Pair rGrid;
-	double psi_bounded_min = _interval.first;
-	double psi_bounded_max = _interval.second;
-
-	for (int i = 0; i < _number_points; i++) {
-		double psi = psi_bounded_min + (double)i * (psi_bounded_max - psi_bounded_min) / ((double)_number_points - 1);
-		auto funct = [psi](double r) {
-			return r * densityGaussian(r) + normalCDF(r) * (1. + r * r) - (1. + psi) *
-				(densityGaussian(r) + r * normalCDF(r)) * (densityGaussian(r) + r * normalCDF(r));
-		};
-		rGrid.push_back({ psi , (ocl::brent_zero(psi_bounded_min - 10., psi_bounded_max + 10., 1e-6, 1e-4, funct)) });
+	if (!_rGrid.empty()) {
+		return _rGrid;
 	}
 
-	return rGrid;
+	GridRootSolver solver(1e-12, 100);
+	_status = solver.solve(_interval, _number_points, _rGrid);
+	return _rGrid;
+}
+
+RootSolverStatus gridFunction::getStatus() const
+{
+	return _status;
 }
 
 Vector_Pair gridFunction::getGridFunctionMu()
@@ -47,7 +44,7 @@ Vector_Pair gridFunction::getGridFunctionMu()
 	double psi_bounded_max = _interval.second;
 
 
-	for (int i = 0; i < _number_points; i++) {
+	for (int i = 0; i < rGrid.size(); i++) {
 		double psi = rGrid[i].first;
 		double functionR = rGrid[i].second;
 		fMuGrid.push_back({ psi , functionR / (densityGaussian(functionR) + functionR * normalCDF(functionR)) });
@@ -64,7 +61,7 @@ Vector_Pair gridFunction::getGridFunctionSigma()
 	double psi_bounded_max = _interval.second;
 
 
-	for (int i = 0; i < _number_points; i++) {
+	for (int i = 0; i < rGrid.size(); i++) {
 		double psi = rGrid[i].first;
 		double functionR = rGrid[i].second;
 		fSigmaGrid.push_back({ psi , 1. / (sqrt(psi) * (densityGaussian(functionR) + functionR * normalCDF(functionR)) ) });
@@ -73,7 +70,7 @@ Vector_Pair gridFunction::getGridFunctionSigma()
 	return fSigmaGrid;
 }
 
-double gridFunction::functionR(double psi, Vector_Pair rGrid)
+double gridFunction::functionR(double psi, const Vector_Pair& rGrid)
 {
 	if (rGrid[0].first >= psi) {
 		return rGrid[0].second;
@@ -90,7 +87,7 @@ double gridFunction::functionR(double psi, Vector_Pair rGrid)
 	return rGrid[rGrid.size() - 1].second;
 }
 
-double gridFunction::functionMu(double psi, Vector_Pair muGrid)
+double gridFunction::functionMu(double psi, const Vector_Pair& muGrid)
 {
 	if (muGrid[0].first >= psi) {
 		return muGrid[0].second;
@@ -107,7 +104,7 @@ double gridFunction::functionMu(double psi, Vector_Pair muGrid)
 	return muGrid[muGrid.size() - 1].second;
 }
 
-double gridFunction::functionSigma(double psi, Vector_Pair sigmaGrid)
+double gridFunction::functionSigma(double psi, const Vector_Pair& sigmaGrid)
 {
 	if (sigmaGrid[0].first >= psi) {
 		return sigmaGrid[0].second;
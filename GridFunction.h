@@ -3,11 +3,17 @@
 #include <vector>
 #include <cmath>
 
+#include "GridRootSolver.h"
+
 using Pair = std::pair<double, double>;
 using Vector_Pair = std::vector<std::pair<double, double>>;
 
+double densityGaussian(double x);
+double normalCDF(double x);
+
 // This object allows us to get the grids for functions used in the TG schema.
 // It needs an interval which would be the domain of the functions, and a number of points to discretize this interval.
+// The grid of r is solved once per object (see GridRootSolver), the grids of mu and sigma are computed from it.
 class gridFunction
 {
 public:
@@ -16,15 +22,19 @@ public:
 	Vector_Pair getGridFunctionR();
 	Vector_Pair getGridFunctionMu();
 	Vector_Pair getGridFunctionSigma();
+	// SUCCESS unless the solver failed on the grid of r, in which case the grids are incomplete
+	RootSolverStatus getStatus() const;
 
-	double functionR(double psi, Vector_Pair rGrid);
-	double functionMu(double psi, Vector_Pair muGrid);
-	double functionSigma(double psi, Vector_Pair sigmaGrid);
+	double functionR(double psi, const Vector_Pair& rGrid);
+	double functionMu(double psi, const Vector_Pair& muGrid);
+	double functionSigma(double psi, const Vector_Pair& sigmaGrid);
 
 
 protected:
 
 	int _number_points;
 	Pair _interval;
+	Vector_Pair _rGrid;
+	RootSolverStatus _status;
 	
 };
\ No newline at end of file
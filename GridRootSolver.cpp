@@ -0,0 +1,116 @@
+#include "GridRootSolver.h"
+#include "GridFunction.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The roots of the equation are around [-2, 5] for the psi used by the TG schema, there is no root beyond these bounds
+static const double R_MIN = -50.;
+static const double R_MAX = 50.;
+
+GridRootSolver::GridRootSolver(double tolerance, int max_iterations) :
+	_tolerance(tolerance), _max_iterations(max_iterations)
+{
+}
+
+void GridRootSolver::momentEquation(double r, double psi, double& value, double& derivative, double& second_derivative)
+{
+	double phi = densityGaussian(r);
+	double cdf = normalCDF(r);
+	double first_moment = phi + r * cdf;
+
+	value = r * phi + cdf * (1. + r * r) - (1. + psi) * first_moment * first_moment;
+	derivative = 2. * first_moment * (1. - (1. + psi) * cdf);
+	second_derivative = 2. * cdf * (1. - (1. + psi) * cdf) - 2. * (1. + psi) * phi * first_moment;
+}
+
+RootSolverStatus GridRootSolver::solve(Pair interval, int number_points, Vector_Pair& rGrid) const
+{
+	rGrid.clear();
+	rGrid.reserve(number_points);
+	double psi_bounded_min = interval.first;
+	double psi_bounded_max = interval.second;
+
+	for (int i = 0; i < number_points; i++) {
+		double psi = psi_bounded_min + (double)i * (psi_bounded_max - psi_bounded_min) / ((double)number_points - 1);
+
+		// Linear extrapolation of the two previous roots, the bracket is searched with the last move as a step
+		double guess = 0.;
+		double bracket_step = 1.;
+		if (i == 1) {
+			guess = rGrid[0].second;
+		}
+		else if (i > 1) {
+			double last_move = rGrid[i - 1].second - rGrid[i - 2].second;
+			guess = rGrid[i - 1].second + last_move;
+			bracket_step = fabs(last_move) + _tolerance;
+		}
+
+		double root;
+		RootSolverStatus status = solvePoint(psi, guess, bracket_step, root);
+		if (status != RootSolverStatus::SUCCESS)
+			return status;
+		rGrid.push_back({ psi, root });
+	}
+	return RootSolverStatus::SUCCESS;
+}
+
+RootSolverStatus GridRootSolver::solvePoint(double psi, double guess, double bracket_step, double& root) const
+{
+	double value, derivative, second_derivative;
+	momentEquation(guess, psi, value, derivative, second_derivative);
+	if (value == 0.) {
+		root = guess;
+		return RootSolverStatus::SUCCESS;
+	}
+
+	// The equation is positive on the left of the root and negative on its right:
+	// we walk from the guess towards the root, doubling the step, until the sign changes
+	double lower = guess, upper = guess;
+	double direction = (value > 0.) ? 1. : -1.;
+	double step = bracket_step;
+	double bound = guess;
+	while (true) {
+		// The walk stops at the bounds: a root is only missed if there is none in [R_MIN, R_MAX]
+		if ((direction > 0. && bound >= R_MAX) || (direction < 0. && bound <= R_MIN))
+			return RootSolverStatus::INVALID_BRACKET;
+		bound = std::min(std::max(bound + direction * step, R_MIN), R_MAX);
+		double bound_value, unused_derivative, unused_second_derivative;
+		momentEquation(bound, psi, bound_value, unused_derivative, unused_second_derivative);
+		if (bound_value == 0.) {
+			root = bound;
+			return RootSolverStatus::SUCCESS;
+		}
+		if ((bound_value > 0.) == (value > 0.)) {
+			if (direction > 0.) lower = bound; else upper = bound;
+			step *= 2.;
+		}
+		else {
+			if (direction > 0.) upper = bound; else lower = bound;
+			break;
+		}
+	}
+
+	// Halley iterations from the guess, kept inside [lower, upper]
+	double r = guess;
+	for (int iteration = 0; iteration < _max_iterations; ++iteration) {
+		double next_r = r - 2. * value * derivative / (2. * derivative * derivative - value * second_derivative);
+		if (!(next_r > lower && next_r < upper))
+			next_r = 0.5 * (lower + upper);
+
+		bool converged = fabs(next_r - r) <= _tolerance * (1. + fabs(r));
+		r = next_r;
+		momentEquation(r, psi, value, derivative, second_derivative);
+		if (converged || value == 0.) {
+			root = r;
+			return RootSolverStatus::SUCCESS;
+		}
+
+		if (value > 0.) lower = r; else upper = r;
+		if (upper - lower <= _tolerance * (1. + fabs(r))) {
+			root = 0.5 * (lower + upper);
+			return RootSolverStatus::SUCCESS;
+		}
+	}
+	return RootSolverStatus::NO_CONVERGENCE;
+}
@@ -0,0 +1,40 @@
+#ifndef GRIDROOTSOLVER_H
+#define GRIDROOTSOLVER_H
+
+#include <vector>
+#include <utility>
+
+using Pair = std::pair<double, double>;
+using Vector_Pair = std::vector<std::pair<double, double>>;
+
+enum class RootSolverStatus
+{
+	SUCCESS,
+	INVALID_BRACKET,	// no sign change found around the starting point
+	NO_CONVERGENCE		// maximum number of iterations reached
+};
+
+// Solves the moment matching equation of the TG schema for r, at every psi of a uniform grid:
+// r * phi(r) + Phi(r) * (1 + r^2) - (1 + psi) * (phi(r) + r * Phi(r))^2 = 0
+// r(psi) is smooth and decreasing, so each point starts from the roots of its neighbors (continuation),
+// with a tight bracket found around that guess and Halley steps using the analytic derivatives of the equation.
+// A step leaving the bracket is replaced by a bisection, so the solver cannot diverge.
+class GridRootSolver
+{
+public:
+	GridRootSolver(double tolerance, int max_iterations);
+
+	// Fills rGrid with the (psi, r) points; on failure rGrid holds the points solved so far
+	RootSolverStatus solve(Pair interval, int number_points, Vector_Pair& rGrid) const;
+
+	// Value, first and second derivatives in r of the moment matching equation
+	static void momentEquation(double r, double psi, double& value, double& derivative, double& second_derivative);
+
+private:
+	RootSolverStatus solvePoint(double psi, double guess, double bracket_step, double& root) const;
+
+	double _tolerance;
+	int _max_iterations;
+};
+
+#endif
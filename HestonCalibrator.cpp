@@ -0,0 +1,305 @@
+#include "HestonCalibrator.h"
+
+#include "RandomEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+static const size_t MAXIMUM_ITERATIONS = 200;
+// Converged when an accepted step decreases the sum of the squares by less than this fraction
+static const double RELATIVE_TOLERANCE = 1e-10;
+// Stalled, not converged, when the damping gets this large
+static const double MAXIMUM_DAMPING = 1e12;
+
+// Parameters in the order kappa, theta, sigma, rho, v0
+static void toArray(const HestonParameters& parameters, double* values)
+{
+	values[0] = parameters.mean_reversion_speed;
+	values[1] = parameters.mean_reversion_level;
+	values[2] = parameters.vol_of_vol;
+	values[3] = parameters.correlation;
+	values[4] = parameters.initial_variance;
+}
+
+static HestonParameters fromArray(const double* values)
+{
+	HestonParameters parameters;
+	parameters.mean_reversion_speed = values[0];
+	parameters.mean_reversion_level = values[1];
+	parameters.vol_of_vol = values[2];
+	parameters.correlation = values[3];
+	parameters.initial_variance = values[4];
+	return parameters;
+}
+
+// Gaussian elimination with partial pivoting: the solution replaces b
+static void solveLinearSystem(double* A, double* b, size_t n)
+{
+	for (size_t column = 0; column < n; ++column)
+	{
+		size_t pivot = column;
+		for (size_t row = column + 1; row < n; ++row)
+			if (std::abs(A[row * n + column]) > std::abs(A[pivot * n + column]))
+				pivot = row;
+		for (size_t k = 0; k < n; ++k)
+			std::swap(A[column * n + k], A[pivot * n + k]);
+		std::swap(b[column], b[pivot]);
+
+		for (size_t row = column + 1; row < n; ++row)
+		{
+			double factor = A[row * n + column] / A[column * n + column];
+			for (size_t k = column; k < n; ++k)
+				A[row * n + k] -= factor * A[column * n + k];
+			b[row] -= factor * b[column];
+		}
+	}
+	for (size_t row = n; row-- > 0;)
+	{
+		for (size_t k = row + 1; k < n; ++k)
+			b[row] -= A[row * n + k] * b[k];
+		b[row] /= A[row * n + row];
+	}
+}
+
+HestonCalibrator::HestonCalibrator(const Vector& time_points, const Vector& maturities, const Vector& market_strikes, double drift)
+	: _time_points(time_points), _maturities(maturities), _market_strikes(market_strikes), _drift(drift), _feller_condition(true),
+	_strike_tolerance(1e-9)
+{
+	HestonParameters lower_bounds = { 0.01, 0.001, 0.01, -0.99, 0.001 };
+	HestonParameters upper_bounds = { 10., 1., 2., 0.99, 1. };
+	setBounds(lower_bounds, upper_bounds);
+}
+
+void HestonCalibrator::setBounds(const HestonParameters& lower_bounds, const HestonParameters& upper_bounds)
+{
+	toArray(lower_bounds, _lower_bounds);
+	toArray(upper_bounds, _upper_bounds);
+}
+
+void HestonCalibrator::setFellerCondition(bool enforce_feller_condition)
+{
+	_feller_condition = enforce_feller_condition;
+}
+
+void HestonCalibrator::setTolerance(double strike_tolerance)
+{
+	_strike_tolerance = strike_tolerance;
+}
+
+// Clamp on the bounds, then lower sigma to the Feller limit (or raise theta when the bound of sigma is above the limit)
+void HestonCalibrator::project(double* parameters) const
+{
+	for (size_t k = 0; k < NUMBER_OF_PARAMETERS; ++k)
+		parameters[k] = std::min(std::max(parameters[k], _lower_bounds[k]), _upper_bounds[k]);
+	if (!_feller_condition)
+		return;
+
+	double kappa = parameters[0], theta = parameters[1];
+	double feller_vol_of_vol = std::sqrt(2. * kappa * theta);
+	if (parameters[2] > feller_vol_of_vol)
+		parameters[2] = std::max(feller_vol_of_vol, _lower_bounds[2]);
+	if (parameters[2] * parameters[2] > 2. * kappa * theta)
+		parameters[1] = std::min(parameters[2] * parameters[2] / (2. * kappa), _upper_bounds[1]);
+}
+
+double HestonCalibrator::evaluate(const double* parameters, double* residuals, double* jacobian) const
+{
+	size_t number_of_maturities = _maturities.size();
+	double sum_of_squares = 0.;
+	if (jacobian == nullptr)
+	{
+		Vector strikes(number_of_maturities);
+		fairPriceTermStructure(parameters[0], parameters[1], parameters[2], parameters[3], _drift, parameters[4],
+			_time_points, _maturities, strikes.data());
+		for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+		{
+			residuals[maturity_index] = strikes[maturity_index] - _market_strikes[maturity_index];
+			sum_of_squares += residuals[maturity_index] * residuals[maturity_index];
+		}
+		return sum_of_squares;
+	}
+
+	using D = Dual<NUMBER_OF_PARAMETERS>;
+	std::vector<D> strikes(number_of_maturities);
+	fairPriceTermStructure(D::variable(parameters[0], 0), D::variable(parameters[1], 1), D::variable(parameters[2], 2),
+		D::variable(parameters[3], 3), D(_drift), D::variable(parameters[4], 4), _time_points, _maturities, strikes.data());
+	for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+	{
+		residuals[maturity_index] = strikes[maturity_index].value - _market_strikes[maturity_index];
+		sum_of_squares += residuals[maturity_index] * residuals[maturity_index];
+		for (size_t k = 0; k < NUMBER_OF_PARAMETERS; ++k)
+			jacobian[maturity_index * NUMBER_OF_PARAMETERS + k] = strikes[maturity_index].gradient[k];
+	}
+	return sum_of_squares;
+}
+
+Vector HestonCalibrator::getModelStrikes(const HestonParameters& parameters) const
+{
+	Vector strikes(_maturities.size());
+	fairPriceTermStructure(parameters.mean_reversion_speed, parameters.mean_reversion_level, parameters.vol_of_vol,
+		parameters.correlation, _drift, parameters.initial_variance, _time_points, _maturities, strikes.data());
+	return strikes;
+}
+
+// Marquardt damping: the normal equations (J^T J + lambda diag(J^T J)) step = -J^T r. The damping decreases after a step
+// reducing the sum of the squares, and increases otherwise.
+HestonCalibrationResult HestonCalibrator::calibrate(const HestonParameters& initial_parameters) const
+{
+	const size_t n = NUMBER_OF_PARAMETERS;
+	size_t number_of_maturities = _maturities.size();
+	Vector residuals(number_of_maturities), trial_residuals(number_of_maturities), jacobian(number_of_maturities * n);
+
+	double parameters[n], trial[n];
+	toArray(initial_parameters, parameters);
+	project(parameters);
+	double sum_of_squares = evaluate(parameters, residuals.data(), jacobian.data());
+
+	double damping = 1e-3;
+	double tolerance_sum_of_squares = _strike_tolerance * _strike_tolerance * number_of_maturities;
+	bool converged = (sum_of_squares <= tolerance_sum_of_squares);
+	bool stalled = false;
+	size_t iteration = 0;
+	while (iteration < MAXIMUM_ITERATIONS && !converged && !stalled)
+	{
+		++iteration;
+		double normal_matrix[n * n], step[n];
+		// On the Feller boundary, when the descent direction leaves it, the step follows it: sigma = sqrt(2 kappa theta) is
+		// eliminated, its column of the Jacobian going to kappa and theta by the chain rule
+		double kappa = parameters[0], theta = parameters[1], sigma = parameters[2];
+		bool feller_active = false;
+		if (_feller_condition && sigma * sigma >= 2. * kappa * theta * (1. - 1e-12))
+		{
+			double gradient[n] = { 0., 0., 0., 0., 0. };
+			for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+				for (size_t j = 0; j < n; ++j)
+					gradient[j] += jacobian[maturity_index * n + j] * residuals[maturity_index];
+			feller_active = (-gradient[2] * sigma + gradient[0] * theta + gradient[1] * kappa > 0.);
+		}
+		Vector step_jacobian(jacobian);
+		if (feller_active)
+		{
+			for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+			{
+				double* row = &step_jacobian[maturity_index * n];
+				row[0] += theta / sigma * row[2];
+				row[1] += kappa / sigma * row[2];
+				row[2] = 0.;
+			}
+		}
+
+		for (size_t j = 0; j < n; ++j)
+		{
+			step[j] = 0.;
+			for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+				step[j] -= step_jacobian[maturity_index * n + j] * residuals[maturity_index];
+			for (size_t k = 0; k < n; ++k)
+			{
+				normal_matrix[j * n + k] = 0.;
+				for (size_t maturity_index = 0; maturity_index < number_of_maturities; ++maturity_index)
+					normal_matrix[j * n + k] += step_jacobian[maturity_index * n + j] * step_jacobian[maturity_index * n + k];
+			}
+		}
+		// The floor keeps the system regular for the parameters the strikes hardly depend on
+		double largest_diagonal = 0.;
+		for (size_t j = 0; j < n; ++j)
+			largest_diagonal = std::max(largest_diagonal, normal_matrix[j * n + j]);
+		for (size_t j = 0; j < n; ++j)
+			normal_matrix[j * n + j] += damping * std::max(normal_matrix[j * n + j], 1e-12 * largest_diagonal + 1e-300);
+		// A parameter on a bound the descent direction points out of stays there: the step is solved in the other parameters
+		for (size_t j = 0; j < n; ++j)
+		{
+			if ((parameters[j] <= _lower_bounds[j] && step[j] < 0.) || (parameters[j] >= _upper_bounds[j] && step[j] > 0.))
+			{
+				for (size_t k = 0; k < n; ++k)
+					normal_matrix[j * n + k] = normal_matrix[k * n + j] = 0.;
+				normal_matrix[j * n + j] = 1.;
+				step[j] = 0.;
+			}
+		}
+		solveLinearSystem(normal_matrix, step, n);
+		if (feller_active)
+			step[2] = (theta * step[0] + kappa * step[1]) / sigma;
+
+		for (size_t j = 0; j < n; ++j)
+			trial[j] = parameters[j] + step[j];
+		project(trial);
+		double trial_sum_of_squares = evaluate(trial, trial_residuals.data(), nullptr);
+
+		if (trial_sum_of_squares < sum_of_squares)
+		{
+			converged = (sum_of_squares - trial_sum_of_squares <= RELATIVE_TOLERANCE * sum_of_squares
+				|| trial_sum_of_squares <= tolerance_sum_of_squares);
+			std::copy(trial, trial + n, parameters);
+			sum_of_squares = evaluate(parameters, residuals.data(), jacobian.data());
+			damping = std::max(damping / 10., 1e-12);
+		}
+		else
+		{
+			damping *= 10.;
+			stalled = (damping > MAXIMUM_DAMPING);
+		}
+	}
+
+	HestonCalibrationResult result;
+	result.parameters = fromArray(parameters);
+	result.root_mean_square_error = std::sqrt(sum_of_squares / number_of_maturities);
+	result.number_of_iterations = iteration;
+	result.converged = converged;
+	return result;
+}
+
+HestonCalibrationResult HestonCalibrator::calibrate(size_t number_of_starts, size_t number_of_threads, unsigned long long seed) const
+{
+	// No start, no calibration: the middle of the bounds, not converged
+	if (number_of_starts == 0) {
+		double middle_parameters[NUMBER_OF_PARAMETERS];
+		for (size_t k = 0; k < NUMBER_OF_PARAMETERS; ++k)
+			middle_parameters[k] = 0.5 * (_lower_bounds[k] + _upper_bounds[k]);
+		HestonCalibrationResult result;
+		result.parameters = fromArray(middle_parameters);
+		result.root_mean_square_error = std::numeric_limits<double>::infinity();
+		result.number_of_iterations = 0;
+		result.converged = false;
+		return result;
+	}
+
+	if (number_of_threads == 0)
+		number_of_threads = std::thread::hardware_concurrency();
+	if (number_of_threads == 0)
+		number_of_threads = 1;
+	if (number_of_threads > number_of_starts)
+		number_of_threads = number_of_starts;
+
+	std::vector<HestonCalibrationResult> results(number_of_starts);
+	std::atomic<size_t> next_start(0);
+
+	auto worker = [&]() {
+		PhiloxEngine engine(seed);
+		for (size_t start_index = next_start++; start_index < number_of_starts; start_index = next_start++)
+		{
+			double uniforms[NUMBER_OF_PARAMETERS], initial_parameters[NUMBER_OF_PARAMETERS];
+			engine.skipTo(start_index, 0);
+			engine.fillUniforms(uniforms, NUMBER_OF_PARAMETERS);
+			for (size_t k = 0; k < NUMBER_OF_PARAMETERS; ++k)
+				initial_parameters[k] = _lower_bounds[k] + uniforms[k] * (_upper_bounds[k] - _lower_bounds[k]);
+			results[start_index] = calibrate(fromArray(initial_parameters));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t thread_index = 1; thread_index < number_of_threads; ++thread_index)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// The first of the best starts, so that ties do not depend on the threads
+	size_t best_start = 0;
+	for (size_t start_index = 1; start_index < number_of_starts; ++start_index)
+		if (results[start_index].root_mean_square_error < results[best_start].root_mean_square_error)
+			best_start = start_index;
+	return results[best_start];
+}
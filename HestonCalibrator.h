@@ -0,0 +1,70 @@
+#ifndef HESTONCALIBRATOR_H
+#define HESTONCALIBRATOR_H
+
+#include "FunctionFairPrice.h"
+
+#include <vector>
+
+struct HestonParameters
+{
+	double mean_reversion_speed;
+	double mean_reversion_level;
+	double vol_of_vol;
+	double correlation;
+	double initial_variance;
+};
+
+struct HestonCalibrationResult
+{
+	HestonParameters parameters;
+	double root_mean_square_error;		// between the model and the market strikes
+	size_t number_of_iterations;		// of the best start
+	bool converged;						// true when the best start met the strike tolerance or stopped decreasing the error, false when it
+										// hit the maximum number of iterations or stalled (no decreasing step however large the damping)
+};
+
+// Calibration of the Heston parameters to a term structure of variance swap strikes: the fair strikes given by
+// fairPriceTermStructure for the maturities are fitted to the market strikes in the least squares sense, by Levenberg-Marquardt.
+// The Jacobian is exact: the fair strikes are computed on Dual numbers carrying their derivatives in the 5 parameters.
+// The parameters stay within bounds, and the Feller condition 2 kappa theta >= sigma^2 is enforced unless disabled,
+// by projection after each step.
+class HestonCalibrator final
+{
+public:
+	// The maturities are increasing, the swaps observe the time points before each maturity (see FairPriceFunction::getFairPrices)
+	HestonCalibrator(const Vector& time_points, const Vector& maturities, const Vector& market_strikes, double drift);
+
+	void setBounds(const HestonParameters& lower_bounds, const HestonParameters& upper_bounds);
+	void setFellerCondition(bool enforce_feller_condition);
+	// The calibration stops when the root mean square error on the strikes is below the tolerance (1e-9 by default, far below
+	// the precision of the market strikes: the strikes hardly depend on sigma and rho, so the last digits take many iterations)
+	void setTolerance(double strike_tolerance);
+
+	// Levenberg-Marquardt from the given parameters (projected on the constraints first)
+	HestonCalibrationResult calibrate(const HestonParameters& initial_parameters) const;
+	// Best of number_of_starts calibrations from random parameters within the bounds (start k uses the path k of a PhiloxEngine
+	// with the given seed), run in parallel: the result does not depend on the number of threads.
+	// With 0 start, the result is the middle of the bounds, not converged, with an infinite error.
+	HestonCalibrationResult calibrate(size_t number_of_starts, size_t number_of_threads, unsigned long long seed) const;
+
+	// Model fair strikes for the maturities
+	Vector getModelStrikes(const HestonParameters& parameters) const;
+
+private:
+	static const size_t NUMBER_OF_PARAMETERS = 5;
+
+	// Sum of the squared residuals, and the Jacobian of the residuals (maturity after maturity) when jacobian is not null
+	double evaluate(const double* parameters, double* residuals, double* jacobian) const;
+	void project(double* parameters) const;
+
+	Vector _time_points;
+	Vector _maturities;
+	Vector _market_strikes;
+	double _drift;
+	double _lower_bounds[NUMBER_OF_PARAMETERS];
+	double _upper_bounds[NUMBER_OF_PARAMETERS];
+	bool _feller_condition;
+	double _strike_tolerance;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "InterpolationTable.h"
+
+#include <stdexcept>
+
+InterpolationTable::InterpolationTable() :
+	_x_min(0.), _x_max(0.), _step(0.), _inverse_step(0.), _values(2, 0.)
+{
+}
+
+InterpolationTable::InterpolationTable(const Vector_Pair& grid, bool store_slopes)
+{
+	if (grid.empty())
+		throw std::invalid_argument("InterpolationTable: empty grid");
+	Vector values;
+	for (const auto& point : grid)
+		values.push_back(point.second);
+	*this = InterpolationTable(grid.front().first, grid.back().first, values, store_slopes);
+}
+
+InterpolationTable::InterpolationTable(double x_min, double x_max, const Vector& values, bool store_slopes) :
+	_x_min(x_min), _x_max(x_max), _values(values)
+{
+	// A single point is a constant function
+	if (_values.size() == 1)
+		_values.push_back(_values[0]);
+
+	_step = (x_max - x_min) / ((double)_values.size() - 1.);
+	_inverse_step = (_step > 0.) ? 1. / _step : 0.;
+
+	if (store_slopes) {
+		for (size_t i = 0; i + 1 < _values.size(); ++i)
+			_slopes.push_back((_values[i + 1] - _values[i]) * _inverse_step);
+	}
+}
+
+void InterpolationTable::evaluate(const double* x, double* values, size_t n) const
+{
+	for (size_t i = 0; i < n; ++i)
+		values[i] = evaluate(x[i]);
+}
+
+size_t InterpolationTable::getNumberPoints() const
+{
+	return _values.size();
+}
+
+double InterpolationTable::getMinimum() const
+{
+	return _x_min;
+}
+
+double InterpolationTable::getMaximum() const
+{
+	return _x_max;
+}
@@ -0,0 +1,49 @@
+#ifndef INTERPOLATIONTABLE_H
+#define INTERPOLATIONTABLE_H
+
+#include <vector>
+#include <algorithm>
+
+using Vector = std::vector<double>;
+using Vector_Pair = std::vector<std::pair<double, double>>;
+
+// Linear interpolation of a function tabulated on a uniform grid, like the grids of the TG schema.
+// The values (and optionally the slopes) are stored contiguously, and the bracket of a point is found by its index on the grid,
+// with no search. Outside of the grid, the first or last value is returned, as in gridFunction.
+class InterpolationTable
+{
+public:
+	InterpolationTable();
+	// The abscissas of the grid must be uniformly spaced, an empty grid throws std::invalid_argument
+	InterpolationTable(const Vector_Pair& grid, bool store_slopes);
+	InterpolationTable(double x_min, double x_max, const Vector& values, bool store_slopes);
+
+	double evaluate(double x) const;
+	// Evaluates n points at once, values may be the same array as x
+	void evaluate(const double* x, double* values, size_t n) const;
+
+	size_t getNumberPoints() const;
+	double getMinimum() const;
+	double getMaximum() const;
+
+private:
+	double _x_min;
+	double _x_max;
+	double _step;
+	double _inverse_step;
+	Vector _values;
+	// Slope on each interval [x_i, x_i+1], empty if not stored
+	Vector _slopes;
+};
+
+inline double InterpolationTable::evaluate(double x) const
+{
+	x = std::min(std::max(x, _x_min), _x_max);
+	size_t index = std::min((size_t)((x - _x_min) * _inverse_step), _values.size() - 2);
+	double distance = x - (_x_min + (double)index * _step);
+	if (!_slopes.empty())
+		return _values[index] + distance * _slopes[index];
+	return _values[index] + distance * (_values[index + 1] - _values[index]) * _inverse_step;
+}
+
+#endif
@@ -1,63 +1,513 @@
 #include "MonteCarloPricer2D.h"
+#include "SobolEngine.h"
+#include "BatchPathSimulator2D.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+// Number of simulations sharing the same partial sum in the parallel pricing
+static const size_t SIMULATIONS_PER_BLOCK = 256;
+// First batch of the adaptive pricing, large enough for a first estimate of the variance
+static const size_t FIRST_ADAPTIVE_BATCH = 16 * SIMULATIONS_PER_BLOCK;
 
 MonteCarloPricer2D::MonteCarloPricer2D(const PathSimulator2D & path_simulator, size_t number_of_simulations, double discount_rate)
-	: _path_simulator(new PathSimulator2D(path_simulator)), _number_of_simulations(number_of_simulations), _discount_rate(discount_rate)
+	: _path_simulator(std::make_shared<const PathSimulator2D>(path_simulator)), _number_of_simulations(number_of_simulations), _discount_rate(discount_rate)
 {
 }
 
-MonteCarloPricer2D::MonteCarloPricer2D(const MonteCarloPricer2D & pricer)
-	: _path_simulator(new PathSimulator2D(*(pricer._path_simulator))), _number_of_simulations(pricer._number_of_simulations), _discount_rate(pricer._discount_rate)
+MonteCarloPricer2D* MonteCarloPricer2D::cloneWithTimePoints(const Vector& time_points) const
 {
+	schema* refined_schema = _path_simulator->getSchema()->cloneWithTimePoints(time_points);
+	MonteCarloPricer2D* pricer = clone();
+	pricer->_path_simulator = std::make_shared<const PathSimulator2D>(refined_schema->getInitialFactors(), time_points, *_path_simulator->getModel(), *refined_schema);
+	delete refined_schema;
+	return pricer;
 }
 
-MonteCarloPricer2D & MonteCarloPricer2D::operator=(const MonteCarloPricer2D & pricer)
+const PathSimulator2D* MonteCarloPricer2D::getPathSimulator() const
 {
-	if (this == &pricer)
-		return *this;
-	else
-	{
-		delete _path_simulator;												// free the storage pointed to by _model
-		_path_simulator = new PathSimulator2D(*(pricer._path_simulator));		// allocate new memory for the pointer
+	return _path_simulator.get();
+}
 
-		// assignment for other fields
-		_number_of_simulations = pricer._number_of_simulations;
-		_discount_rate = pricer._discount_rate;
+double MonteCarloPricer2D::price() const
+{
+	double price = 0.;
+	std::unique_ptr<PathAccumulator> accumulator(createAccumulator());
+
+	for (size_t simulation_index = 0; simulation_index < _number_of_simulations; ++simulation_index)
+	{
+		_path_simulator->path(*accumulator);
+		price += path_price(*accumulator, 0);
 	}
-	return *this;
+	price /= _number_of_simulations;
+	return price;
 }
 
-MonteCarloPricer2D::~MonteCarloPricer2D()
+size_t MonteCarloPricer2D::runBlocks(size_t first_simulation, size_t number_of_simulations, size_t number_of_threads, const RandomEngine& engine,
+	const BlockFunction& simulate_block) const
 {
-	delete _path_simulator; 
+	size_t number_of_blocks = (number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	if (number_of_threads == 0)
+		number_of_threads = std::thread::hardware_concurrency();
+	if (number_of_threads == 0)
+		number_of_threads = 1;
+	if (number_of_threads > number_of_blocks)
+		number_of_threads = number_of_blocks;
+
+	std::atomic<size_t> next_block(0);
+
+	// Each worker takes the next block available, so the blocks are balanced between the threads
+	auto worker = [&]() {
+		std::unique_ptr<RandomEngine> thread_engine(engine.clone());
+		std::unique_ptr<PathAccumulator> accumulator(createAccumulator());
+		for (size_t block_index = next_block++; block_index < number_of_blocks; block_index = next_block++)
+		{
+			size_t first_block_simulation = first_simulation + block_index * SIMULATIONS_PER_BLOCK;
+			size_t last_block_simulation = std::min(first_block_simulation + SIMULATIONS_PER_BLOCK, first_simulation + number_of_simulations);
+			simulate_block(block_index, first_block_simulation, last_block_simulation, *thread_engine, *accumulator);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t thread_index = 1; thread_index < number_of_threads; ++thread_index)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return number_of_blocks;
 }
 
-double MonteCarloPricer2D::price() const
+double MonteCarloPricer2D::price(size_t number_of_threads, unsigned long long seed) const
 {
+	return price(number_of_threads, PhiloxEngine(seed));
+}
+
+double MonteCarloPricer2D::price(size_t number_of_threads, const RandomEngine& engine) const
+{
+	size_t number_of_blocks = (_number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	std::vector<double> block_prices(number_of_blocks, 0.);
+
+	runBlocks(0, _number_of_simulations, number_of_threads, engine,
+		[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& engine, PathAccumulator& accumulator) {
+			double block_price = 0.;
+			for (size_t simulation_index = first_simulation; simulation_index < last_simulation; ++simulation_index)
+			{
+				_path_simulator->path(simulation_index, engine, accumulator);
+				block_price += path_price(accumulator, 0);
+			}
+			block_prices[block_index] = block_price;
+		});
+
+	// The reduction is always done in the same order, to get the same result whatever the number of threads
 	double price = 0.;
+	for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
+		price += block_prices[block_index];
+	price /= _number_of_simulations;
+	return price;
+}
 
-	for (size_t simulation_index = 0; simulation_index < _number_of_simulations; ++simulation_index)
+QuasiMonteCarloResult MonteCarloPricer2D::priceQuasiMonteCarlo(size_t number_of_replicates, size_t number_of_threads, unsigned long long seed) const
+{
+	// The replicates are independent, so the error is estimated from their dispersion (the points of a replicate are not)
+	RunningStatistics statistics;
+	for (size_t replicate_index = 0; replicate_index < number_of_replicates; ++replicate_index)
+		statistics.add(price(number_of_threads, SobolEngine(_path_simulator->getTimePoints(), seed + replicate_index)));
+
+	QuasiMonteCarloResult result;
+	result.price = statistics.getMean();
+	result.standard_error = statistics.getStandardError();
+	result.number_of_replicates = number_of_replicates;
+	return result;
+}
+
+double MonteCarloPricer2D::path_control(const PathAccumulator& accumulator, size_t path_index) const
+{
+	return accumulator.batchValue(path_index);
+}
+
+ControlVariateResult MonteCarloPricer2D::priceWithControlVariate(double control_expectation, size_t number_of_threads, unsigned long long seed) const
+{
+	size_t number_of_blocks = (_number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	std::vector<RunningCovariance> block_statistics(number_of_blocks);
+
+	// x is the control, y the payoff
+	runBlocks(0, _number_of_simulations, number_of_threads, PhiloxEngine(seed),
+		[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& engine, PathAccumulator& accumulator) {
+			RunningCovariance statistics;
+			for (size_t simulation_index = first_simulation; simulation_index < last_simulation; ++simulation_index)
+			{
+				_path_simulator->path(simulation_index, engine, accumulator);
+				statistics.add(path_control(accumulator, 0), path_price(accumulator, 0));
+			}
+			block_statistics[block_index] = statistics;
+		});
+
+	RunningCovariance statistics;
+	for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
+		statistics.merge(block_statistics[block_index]);
+
+	ControlVariateResult result;
+	double count = (double)statistics.getCount();
+	double variance_control = statistics.getVarianceX();
+	double variance_payoff = statistics.getVarianceY();
+	result.coefficient = (variance_control > 0.) ? statistics.getCovariance() / variance_control : 0.;
+	result.plain_price = statistics.getMeanY();
+	result.price = result.plain_price - result.coefficient * (statistics.getMeanX() - control_expectation);
+
+	// Residual variance of the payoff once the part explained by the control is removed
+	double residual_variance = std::max(variance_payoff - result.coefficient * statistics.getCovariance(), 0.);
+	result.plain_standard_error = sqrt(variance_payoff / count);
+	result.standard_error = sqrt(residual_variance / count);
+	result.variance_reduction = (residual_variance > 0.) ? variance_payoff / residual_variance : std::numeric_limits<double>::infinity();
+	return result;
+}
+
+VarianceReductionResult MonteCarloPricer2D::priceWithVarianceReduction(bool antithetic, bool moment_matching, size_t number_of_threads, unsigned long long seed) const
+{
+	size_t number_of_blocks = (_number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	std::vector<RunningStatistics> block_paths(number_of_blocks);
+	std::vector<RunningStatistics> block_units(number_of_blocks);
+
+	PhiloxEngine engine(seed);
+	std::unique_ptr<RandomEngine> block_engine(antithetic ? (RandomEngine*)new AntitheticEngine(engine) : engine.clone());
+
+	runBlocks(0, _number_of_simulations, number_of_threads, *block_engine,
+		[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& engine, PathAccumulator& accumulator) {
+			BatchPathSimulator2D batch_simulator(*_path_simulator->getSchema(), last_simulation - first_simulation);
+			batch_simulator.setMomentMatching(moment_matching);
+			batch_simulator.simulate(first_simulation, engine, accumulator);
+
+			RunningStatistics paths, units;
+			for (size_t path_index = 0; path_index < batch_simulator.getNumberOfPaths(); ++path_index)
+			{
+				double payoff = path_price(accumulator, path_index);
+				paths.add(payoff);
+				// the blocks start on an even simulation, so a pair is never split (the last path may have no partner)
+				if (moment_matching)
+					continue;
+				if (!antithetic)
+					units.add(payoff);
+				else if (path_index % 2 == 1)
+					units.add(0.5 * (path_price(accumulator, path_index - 1) + payoff));
+				else if (path_index + 1 == batch_simulator.getNumberOfPaths())
+					units.add(payoff);
+			}
+			if (moment_matching)
+				units.add(paths.getMean());
+			block_paths[block_index] = paths;
+			block_units[block_index] = units;
+		});
+
+	RunningStatistics paths, units;
+	for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
 	{
-		Vector_Pair path = _path_simulator->path();
-		price += path_price(path);
+		paths.merge(block_paths[block_index]);
+		units.merge(block_units[block_index]);
 	}
-	price /= _number_of_simulations;
-	return price;
+
+	VarianceReductionResult result;
+	result.price = paths.getMean();
+	result.standard_error = units.getStandardError();
+	result.plain_standard_error = paths.getStandardError();
+	result.variance_ratio = (result.standard_error > 0.) ?
+		(result.plain_standard_error * result.plain_standard_error) / (result.standard_error * result.standard_error) : std::numeric_limits<double>::infinity();
+	return result;
 }
 
+RunningStatistics MonteCarloPricer2D::priceCorrection(const MonteCarloPricer2D* coarse_pricer, size_t coarsening, size_t first_simulation,
+	size_t number_of_simulations, size_t number_of_threads, unsigned long long seed) const
+{
+	size_t number_of_blocks = (number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	std::vector<RunningStatistics> block_statistics(number_of_blocks);
+	size_t number_of_steps = _path_simulator->getTimePoints().size() - 1;
+	PhiloxEngine engine(seed);
+
+	runBlocks(first_simulation, number_of_simulations, number_of_threads, CoarsenedEngine(engine, number_of_steps, 1),
+		[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& fine_engine, PathAccumulator& accumulator) {
+			// The coarse paths have their own engine and accumulator, on their grid
+			std::unique_ptr<PathAccumulator> coarse_accumulator(coarse_pricer ? coarse_pricer->createAccumulator() : nullptr);
+			CoarsenedEngine coarse_engine(engine, number_of_steps, coarsening);
+
+			RunningStatistics statistics;
+			for (size_t simulation_index = first_simulation; simulation_index < last_simulation; ++simulation_index)
+			{
+				_path_simulator->path(simulation_index, fine_engine, accumulator);
+				double correction = path_price(accumulator, 0);
+				if (coarse_pricer)
+				{
+					coarse_pricer->_path_simulator->path(simulation_index, coarse_engine, *coarse_accumulator);
+					correction -= coarse_pricer->path_price(*coarse_accumulator, 0);
+				}
+				statistics.add(correction);
+			}
+			block_statistics[block_index] = statistics;
+		});
+
+	RunningStatistics statistics;
+	for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
+		statistics.merge(block_statistics[block_index]);
+	return statistics;
+}
+
+AdaptivePricingResult MonteCarloPricer2D::priceAdaptive(double target_standard_error, double time_budget, size_t number_of_threads, unsigned long long seed) const
+{
+	auto start = std::chrono::steady_clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+	RunningStatistics statistics;
+	size_t batch_size = std::min(FIRST_ADAPTIVE_BATCH, _number_of_simulations);
+	bool converged = false;
+
+	while (batch_size > 0)
+	{
+		size_t number_of_blocks = (batch_size + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+		std::vector<RunningStatistics> block_statistics(number_of_blocks);
+		runBlocks(statistics.getCount(), batch_size, number_of_threads, PhiloxEngine(seed),
+			[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& engine, PathAccumulator& accumulator) {
+				RunningStatistics block;
+				for (size_t simulation_index = first_simulation; simulation_index < last_simulation; ++simulation_index)
+				{
+					_path_simulator->path(simulation_index, engine, accumulator);
+					block.add(path_price(accumulator, 0));
+				}
+				block_statistics[block_index] = block;
+			});
+		for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
+			statistics.merge(block_statistics[block_index]);
+
+		converged = statistics.getStandardError() <= target_standard_error;
+		if (converged || (time_budget > 0. && elapsed() >= time_budget))
+			break;
+
+		// Paths still needed according to the current variance, at most doubling the sample and in whole blocks
+		double needed = statistics.getVariance() / (target_standard_error * target_standard_error) - (double)statistics.getCount();
+		batch_size = (size_t)std::min(std::max(needed, (double)SIMULATIONS_PER_BLOCK), (double)statistics.getCount());
+		batch_size = (batch_size + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK * SIMULATIONS_PER_BLOCK;
+		batch_size = std::min(batch_size, _number_of_simulations - statistics.getCount());
+
+		// No more than what the remaining time allows, at the speed observed so far
+		if (time_budget > 0.)
+		{
+			// The budget may run out since the check above, and the cast needs a finite value in range
+			double seconds_per_simulation = elapsed() / (double)statistics.getCount();
+			double remaining_time = std::max(time_budget - elapsed(), 0.);
+			double affordable_simulations = (seconds_per_simulation > 0.) ? remaining_time / seconds_per_simulation : (double)batch_size;
+			size_t affordable = (size_t)std::min(affordable_simulations, (double)batch_size);
+			affordable = std::max(affordable / SIMULATIONS_PER_BLOCK, (size_t)1) * SIMULATIONS_PER_BLOCK;
+			batch_size = std::min(batch_size, affordable);
+		}
+	}
+
+	AdaptivePricingResult result;
+	result.price = statistics.getMean();
+	result.standard_error = statistics.getStandardError();
+	result.confidence_lower = result.price - 1.96 * result.standard_error;
+	result.confidence_upper = result.price + 1.96 * result.standard_error;
+	result.number_of_simulations = statistics.getCount();
+	result.elapsed_seconds = elapsed();
+	result.converged = converged;
+	return result;
+}
 
 MonteCarloVarianceSwapPricer2D::MonteCarloVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call)
-	: MonteCarloPricer2D(path_simulator, number_of_simulations, discount_rate), _strike(strike), _is_call(is_call)
+	: MonteCarloVarianceSwapPricer2D(path_simulator, number_of_simulations, discount_rate, strike, is_call, path_simulator.getTimePoints())
+{}
+
+MonteCarloVarianceSwapPricer2D::MonteCarloVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+	const Vector& observation_times)
+	: MonteCarloPricer2D(path_simulator, number_of_simulations, discount_rate), _strike(strike), _is_call(is_call),
+	_observation_times(observation_times), _maturity(path_simulator.getTimePoints().back()), _conditional(false)
 {}
 
-double MonteCarloVarianceSwapPricer2D::path_price(const Vector_Pair& path) const
+MonteCarloVarianceSwapPricer2D* MonteCarloVarianceSwapPricer2D::clone() const
+{
+	return new MonteCarloVarianceSwapPricer2D(*this);
+}
+
+void MonteCarloVarianceSwapPricer2D::setConditionalMonteCarlo(bool conditional)
+{
+	// the conditional moments come from the trapezoid step plan, not from what schemaIG samples
+	if (conditional && _path_simulator->getSchema()->samplesIntegratedVariance())
+		throw std::invalid_argument("conditional Monte Carlo does not support a schema sampling the integrated variance");
+	_conditional = conditional;
+}
+
+PathAccumulator* MonteCarloVarianceSwapPricer2D::createAccumulator() const
+{
+	if (_conditional)
+		return new ConditionalRealizedVarianceAccumulator(_path_simulator->getSchema()->getStepPlan(), _path_simulator->getTimePoints(), _observation_times);
+	return new RealizedVarianceAccumulator(_path_simulator->getTimePoints(), _observation_times);
+}
+
+double MonteCarloVarianceSwapPricer2D::path_price(const PathAccumulator& accumulator, size_t path_index) const
 {
-	// payoff for this specific path scenario
-	double volatility_at_maturity = path.at(path.size() - 1).second;
-	double path_payoff = (_is_call ? volatility_at_maturity - _strike : _strike - volatility_at_maturity);
+	// payoff for this specific path scenario: annualized realized variance against the variance strike
+	double realized_variance = accumulator.batchValue(path_index);
+	double path_payoff = (_is_call ? realized_variance - _strike : _strike - realized_variance);
 
 	// Discounted payoff = PV
-	double maturity = _path_simulator->getTimePoints().at(_path_simulator->getTimePoints().size() - 1);
-	double path_price = std::exp(-_discount_rate * maturity) * path_payoff;
+	double path_price = std::exp(-_discount_rate * _maturity) * path_payoff;
 
 	return path_price;
 }
+
+MonteCarloCappedVarianceSwapPricer2D::MonteCarloCappedVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+	double cap)
+	: MonteCarloVarianceSwapPricer2D(path_simulator, number_of_simulations, discount_rate, strike, is_call), _cap(cap)
+{}
+
+MonteCarloCappedVarianceSwapPricer2D* MonteCarloCappedVarianceSwapPricer2D::clone() const
+{
+	return new MonteCarloCappedVarianceSwapPricer2D(*this);
+}
+
+PathAccumulator* MonteCarloCappedVarianceSwapPricer2D::createAccumulator() const
+{
+	return new RealizedVarianceAccumulator(_path_simulator->getTimePoints(), _observation_times);
+}
+
+double MonteCarloCappedVarianceSwapPricer2D::path_price(const PathAccumulator& accumulator, size_t path_index) const
+{
+	double capped_variance = std::min(accumulator.batchValue(path_index), _cap);
+	double path_payoff = (_is_call ? capped_variance - _strike : _strike - capped_variance);
+	return std::exp(-_discount_rate * _maturity) * path_payoff;
+}
+
+MonteCarloVolatilitySwapPricer2D::MonteCarloVolatilitySwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double volatility_strike, bool is_call)
+	: MonteCarloVarianceSwapPricer2D(path_simulator, number_of_simulations, discount_rate, volatility_strike, is_call)
+{}
+
+MonteCarloVolatilitySwapPricer2D* MonteCarloVolatilitySwapPricer2D::clone() const
+{
+	return new MonteCarloVolatilitySwapPricer2D(*this);
+}
+
+PathAccumulator* MonteCarloVolatilitySwapPricer2D::createAccumulator() const
+{
+	return new RealizedVarianceAccumulator(_path_simulator->getTimePoints(), _observation_times);
+}
+
+double MonteCarloVolatilitySwapPricer2D::path_price(const PathAccumulator& accumulator, size_t path_index) const
+{
+	double realized_volatility = sqrt(accumulator.batchValue(path_index));
+	double path_payoff = (_is_call ? realized_volatility - _strike : _strike - realized_volatility);
+	return std::exp(-_discount_rate * _maturity) * path_payoff;
+}
+
+MonteCarloCorridorVarianceSwapPricer2D::MonteCarloCorridorVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+	double lower_barrier, double upper_barrier)
+	: MonteCarloVarianceSwapPricer2D(path_simulator, number_of_simulations, discount_rate, strike, is_call),
+	_lower_barrier(lower_barrier), _upper_barrier(upper_barrier)
+{}
+
+MonteCarloCorridorVarianceSwapPricer2D* MonteCarloCorridorVarianceSwapPricer2D::clone() const
+{
+	return new MonteCarloCorridorVarianceSwapPricer2D(*this);
+}
+
+PathAccumulator* MonteCarloCorridorVarianceSwapPricer2D::createAccumulator() const
+{
+	return new CorridorVarianceAccumulator(_path_simulator->getTimePoints(), _observation_times, _lower_barrier, _upper_barrier);
+}
+
+MonteCarloPortfolioPricer2D::MonteCarloPortfolioPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations)
+	: MonteCarloPricer2D(path_simulator, number_of_simulations, 0.)
+{}
+
+MonteCarloPortfolioPricer2D::MonteCarloPortfolioPricer2D(const MonteCarloPortfolioPricer2D& pricer)
+	: MonteCarloPricer2D(pricer)
+{
+	for (const MonteCarloPricer2D* contract : pricer._contracts)
+		_contracts.push_back(contract->clone());
+}
+
+MonteCarloPortfolioPricer2D& MonteCarloPortfolioPricer2D::operator=(const MonteCarloPortfolioPricer2D& pricer)
+{
+	if (!(this == &pricer)) {
+		MonteCarloPricer2D::operator=(pricer);
+		for (MonteCarloPricer2D* contract : _contracts)
+			delete contract;
+		_contracts.clear();
+		for (const MonteCarloPricer2D* contract : pricer._contracts)
+			_contracts.push_back(contract->clone());
+	}
+	return *this;
+}
+
+MonteCarloPortfolioPricer2D::~MonteCarloPortfolioPricer2D()
+{
+	for (MonteCarloPricer2D* contract : _contracts)
+		delete contract;
+}
+
+MonteCarloPortfolioPricer2D* MonteCarloPortfolioPricer2D::clone() const
+{
+	return new MonteCarloPortfolioPricer2D(*this);
+}
+
+void MonteCarloPortfolioPricer2D::addContract(const MonteCarloPricer2D& contract)
+{
+	// The accumulator of the contract is fed the paths of the portfolio, indexed by the steps of its own grid
+	if (contract.getPathSimulator()->getTimePoints() != _path_simulator->getTimePoints())
+		throw std::invalid_argument("MonteCarloPortfolioPricer2D: the contract is not built on the time grid of the portfolio");
+	_contracts.push_back(contract.clone());
+}
+
+size_t MonteCarloPortfolioPricer2D::getNumberOfContracts() const
+{
+	return _contracts.size();
+}
+
+PathAccumulator* MonteCarloPortfolioPricer2D::createAccumulator() const
+{
+	PortfolioAccumulator* accumulator = new PortfolioAccumulator();
+	for (const MonteCarloPricer2D* contract : _contracts)
+		accumulator->addAccumulator(contract->createAccumulator());
+	return accumulator;
+}
+
+double MonteCarloPortfolioPricer2D::path_price(const PathAccumulator& accumulator, size_t path_index) const
+{
+	const PortfolioAccumulator& portfolio_accumulator = static_cast<const PortfolioAccumulator&>(accumulator);
+	double path_price = 0.;
+	for (size_t contract_index = 0; contract_index < _contracts.size(); ++contract_index)
+		path_price += _contracts[contract_index]->path_price(portfolio_accumulator.getAccumulator(contract_index), path_index);
+	return path_price;
+}
+
+std::vector<ContractPrice> MonteCarloPortfolioPricer2D::priceContracts(size_t number_of_threads, unsigned long long seed) const
+{
+	size_t number_of_contracts = _contracts.size();
+	size_t number_of_blocks = (_number_of_simulations + SIMULATIONS_PER_BLOCK - 1) / SIMULATIONS_PER_BLOCK;
+	// Statistics of every contract in every block, contract after contract
+	std::vector<RunningStatistics> block_statistics(number_of_blocks * number_of_contracts);
+
+	runBlocks(0, _number_of_simulations, number_of_threads, PhiloxEngine(seed),
+		[&](size_t block_index, size_t first_simulation, size_t last_simulation, RandomEngine& engine, PathAccumulator& accumulator) {
+			const PortfolioAccumulator& portfolio_accumulator = static_cast<const PortfolioAccumulator&>(accumulator);
+			RunningStatistics* statistics = &block_statistics[block_index * number_of_contracts];
+			for (size_t simulation_index = first_simulation; simulation_index < last_simulation; ++simulation_index)
+			{
+				_path_simulator->path(simulation_index, engine, accumulator);
+				for (size_t contract_index = 0; contract_index < number_of_contracts; ++contract_index)
+					statistics[contract_index].add(_contracts[contract_index]->path_price(portfolio_accumulator.getAccumulator(contract_index), 0));
+			}
+		});
+
+	std::vector<ContractPrice> prices(number_of_contracts);
+	for (size_t contract_index = 0; contract_index < number_of_contracts; ++contract_index)
+	{
+		RunningStatistics statistics;
+		for (size_t block_index = 0; block_index < number_of_blocks; ++block_index)
+			statistics.merge(block_statistics[block_index * number_of_contracts + contract_index]);
+		prices[contract_index].price = statistics.getMean();
+		prices[contract_index].standard_error = statistics.getStandardError();
+	}
+	return prices;
+}
@@ -5,22 +5,113 @@
 #include "PathSimulator2D.h"
 #endif 
 
+#include "PathAccumulator.h"
+#include "RunningStatistics.h"
+
+#include <functional>
+#include <memory>
+
+// Price estimated with a control variate: the payoff Y of each path is paired with a control X of known expectation,
+// and the estimator is mean(Y) - coefficient * (mean(X) - E[X]), the coefficient being estimated from the same paths.
+struct ControlVariateResult
+{
+	double price;
+	double plain_price;				// mean(Y), without the control variate
+	double coefficient;				// Cov(X, Y) / Var(X)
+	double standard_error;			// of the adjusted price
+	double plain_standard_error;	// of the plain price
+	double variance_reduction;		// Var(Y) / Var(Y - coefficient * X), infinite when Y is linear in X
+};
+
+// Randomized quasi Monte Carlo price: mean of independent replicates of a scrambled point set, and its standard error
+struct QuasiMonteCarloResult
+{
+	double price;
+	double standard_error;			// from the dispersion between the replicates
+	size_t number_of_replicates;
+};
+
+// Price estimated with antithetic paths and/or moment matching, with the variance ratio achieved:
+// Var(Y) / N (the squared standard error of N independent paths) divided by the squared standard error obtained
+struct VarianceReductionResult
+{
+	double price;
+	double standard_error;
+	double plain_standard_error;	// estimated from the variance of the payoffs, as if the paths were independent
+	double variance_ratio;
+};
+
+// Price estimated until a target standard error is reached, with a 95% confidence interval
+struct AdaptivePricingResult
+{
+	double price;
+	double standard_error;
+	double confidence_lower;
+	double confidence_upper;
+	size_t number_of_simulations;	// paths actually simulated
+	double elapsed_seconds;
+	bool converged;					// false when stopped by the time budget or the maximum number of simulations
+};
+
 class MonteCarloPricer2D
 {
 public:
 	MonteCarloPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate);
 
-	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
-	MonteCarloPricer2D(const MonteCarloPricer2D& pricer);
-	MonteCarloPricer2D& operator=(const MonteCarloPricer2D& pricer);
-	virtual ~MonteCarloPricer2D();
+	// The path simulator never changes once the pricer is built, so the copies share it
+	virtual ~MonteCarloPricer2D() = default;
+	virtual MonteCarloPricer2D* clone() const = 0;
+	// Same pricer, the paths being simulated on another time grid
+	MonteCarloPricer2D* cloneWithTimePoints(const Vector& time_points) const;
+	const PathSimulator2D* getPathSimulator() const;
 
-	virtual double path_price(const Vector_Pair& path) const = 0;
+	// The paths are not stored: the simulator streams each step into an accumulator, and the payoff is read from it
+	// (path_index is the index of the path in the batch of the accumulator, 0 for a single path)
+	virtual PathAccumulator* createAccumulator() const = 0;
+	virtual double path_price(const PathAccumulator& accumulator, size_t path_index) const = 0;
 	double price() const;
+	// Parallel pricing: each simulation draws from its own (path index) substream of a PhiloxEngine with the given seed,
+	// and the simulations are split in blocks having their own partial sum.
+	// The result only depends on the seed, not on the number of threads (0 means one thread per core).
+	double price(size_t number_of_threads, unsigned long long seed) const;
+	// Same with any engine: each thread works on its own copy of the engine, simulation i reading path i
+	double price(size_t number_of_threads, const RandomEngine& engine) const;
+	// Randomized quasi Monte Carlo: number_of_replicates prices on SobolEngines with the seeds seed, seed + 1, ...
+	QuasiMonteCarloResult priceQuasiMonteCarlo(size_t number_of_replicates, size_t number_of_threads, unsigned long long seed) const;
+
+	// Control of a path, by default the value of the accumulator (the realized variance for the variance swaps)
+	virtual double path_control(const PathAccumulator& accumulator, size_t path_index) const;
+	// Parallel pricing with the path control as control variate, control_expectation being its exact expectation
+	// (for the realized variance, the fair strike given by FairPriceFunction on the same observation dates)
+	ControlVariateResult priceWithControlVariate(double control_expectation, size_t number_of_threads, unsigned long long seed) const;
+
+	// Parallel pricing on batches of paths, with antithetic pairs (paths 2k and 2k + 1 are mirrors of each other) and/or
+	// the normals of each step matched to their first two moments over each block of paths. The standard error is taken
+	// over the independent units: the pairs, or the blocks with moment matching.
+	VarianceReductionResult priceWithVarianceReduction(bool antithetic, bool moment_matching, size_t number_of_threads, unsigned long long seed) const;
+
+	// Multilevel correction: statistics of the payoff on this pricer grid minus the payoff on the grid of coarse_pricer,
+	// each coarse step being made of coarsening steps of this grid and driven by the same normals (CoarsenedEngine).
+	// Without coarse pricer, statistics of the payoff itself. Runs the simulations [first_simulation, first_simulation + number_of_simulations).
+	RunningStatistics priceCorrection(const MonteCarloPricer2D* coarse_pricer, size_t coarsening, size_t first_simulation,
+		size_t number_of_simulations, size_t number_of_threads, unsigned long long seed) const;
+
+	// Adaptive pricing: the simulations run in batches until the standard error is below target_standard_error,
+	// the time budget (in seconds, 0 for none) is spent, or the number of simulations of the pricer is reached.
+	// Simulation i always reads path i of the seed, so the price only depends on the number of paths used.
+	AdaptivePricingResult priceAdaptive(double target_standard_error, double time_budget, size_t number_of_threads, unsigned long long seed) const;
 
 
 protected:
-	const PathSimulator2D* _path_simulator;
+	// Runs the simulations [first_simulation, first_simulation + number_of_simulations) on number_of_threads threads (0 means one per core).
+	// They are cut in blocks, and simulate_block(block_index, first, last, engine, accumulator) is called once per block
+	// by the thread which takes it, with the engine and the accumulator of this thread. Each thread clones the engine and
+	// simulation i draws from its path i, so the blocks only depend on the engine. Returns the number of blocks.
+	using BlockFunction = std::function<void(size_t, size_t, size_t, RandomEngine&, PathAccumulator&)>;
+	size_t runBlocks(size_t first_simulation, size_t number_of_simulations, size_t number_of_threads, const RandomEngine& engine,
+		const BlockFunction& simulate_block) const;
+
+	std::shared_ptr<const PathSimulator2D> _path_simulator;
 	size_t _number_of_simulations;
 	double _discount_rate;
 };
@@ -29,12 +120,103 @@ protected:
 class MonteCarloVarianceSwapPricer2D : public MonteCarloPricer2D
 {
 public:
+	// The realized variance is observed at every time point of the simulation
 	MonteCarloVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call);
+	MonteCarloVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+		const Vector& observation_times);
 
-	double path_price(const Vector_Pair& path) const override;
+	// Conditional Monte Carlo: only the variance is simulated, and the realized variance is replaced by its expectation
+	// given the variance path. Same price (the payoff is linear in the realized variance), fewer draws and a smaller variance.
+	// Throws std::invalid_argument for a schema sampling the integrated variance (schemaIG).
+	void setConditionalMonteCarlo(bool conditional);
+	MonteCarloVarianceSwapPricer2D* clone() const override;
+
+	PathAccumulator* createAccumulator() const override;
+	double path_price(const PathAccumulator& accumulator, size_t path_index) const override;
 protected:
 
 	double _strike;
 	bool _is_call;
+	Vector _observation_times;
+	double _maturity;
+	bool _conditional;
+};
+
+// Capped variance swap: the realized variance is capped before being compared to the strike
+class MonteCarloCappedVarianceSwapPricer2D : public MonteCarloVarianceSwapPricer2D
+{
+public:
+	MonteCarloCappedVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+		double cap);
+
+	MonteCarloCappedVarianceSwapPricer2D* clone() const override;
+	// The cap is not linear in the realized variance: the spot is always simulated
+	PathAccumulator* createAccumulator() const override;
+	double path_price(const PathAccumulator& accumulator, size_t path_index) const override;
+protected:
+
+	double _cap;
+};
+
+// Volatility swap: square root of the realized variance against a volatility strike
+class MonteCarloVolatilitySwapPricer2D : public MonteCarloVarianceSwapPricer2D
+{
+public:
+	MonteCarloVolatilitySwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double volatility_strike, bool is_call);
+
+	MonteCarloVolatilitySwapPricer2D* clone() const override;
+	// The square root is not linear in the realized variance: the spot is always simulated
+	PathAccumulator* createAccumulator() const override;
+	double path_price(const PathAccumulator& accumulator, size_t path_index) const override;
+};
+
+// Corridor variance swap: only the returns starting with a spot inside [lower_barrier, upper_barrier] are counted
+class MonteCarloCorridorVarianceSwapPricer2D : public MonteCarloVarianceSwapPricer2D
+{
+public:
+	MonteCarloCorridorVarianceSwapPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations, double discount_rate, double strike, bool is_call,
+		double lower_barrier, double upper_barrier);
+
+	MonteCarloCorridorVarianceSwapPricer2D* clone() const override;
+	PathAccumulator* createAccumulator() const override;
+protected:
+
+	double _lower_barrier;
+	double _upper_barrier;
+};
+
+// Price and standard error of one contract of a portfolio
+struct ContractPrice
+{
+	double price;
+	double standard_error;
+};
+
+// Portfolio of contracts on the same underlying and time grid: each path is simulated once, and the accumulators
+// of every contract are fed in the same pass. The contracts are pricers whose payoff (createAccumulator and path_price)
+// is evaluated on the paths of the portfolio, their own path simulator is not used: they must be built on the same time grid.
+// The payoff of the portfolio itself is the sum of the payoffs of the contracts.
+class MonteCarloPortfolioPricer2D final : public MonteCarloPricer2D
+{
+public:
+	MonteCarloPortfolioPricer2D(const PathSimulator2D& path_simulator, size_t number_of_simulations);
+	// Copy constructor, Assignement operator and Destructor are NEEDED because the contracts are POINTERS
+	MonteCarloPortfolioPricer2D(const MonteCarloPortfolioPricer2D& pricer);
+	MonteCarloPortfolioPricer2D& operator=(const MonteCarloPortfolioPricer2D& pricer);
+	~MonteCarloPortfolioPricer2D();
+	MonteCarloPortfolioPricer2D* clone() const override;
+
+	// Throws std::invalid_argument if the contract is not built on the same time points as the portfolio
+	void addContract(const MonteCarloPricer2D& contract);
+	size_t getNumberOfContracts() const;
+
+	PathAccumulator* createAccumulator() const override;
+	double path_price(const PathAccumulator& accumulator, size_t path_index) const override;
+
+	// Parallel pricing of every contract on the same paths (simulation i reads path i of a PhiloxEngine with the given seed)
+	std::vector<ContractPrice> priceContracts(size_t number_of_threads, unsigned long long seed) const;
+
+private:
+	std::vector<MonteCarloPricer2D*> _contracts;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "MultilevelMonteCarloPricer2D.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+
+// Paths of a new level before its variance is known, and granularity of the number of paths (the blocks of the pricers)
+static const size_t PILOT_SIMULATIONS = 1024;
+static const size_t SIMULATIONS_GRANULARITY = 256;
+
+MultilevelMonteCarloPricer2D::MultilevelMonteCarloPricer2D(const MonteCarloPricer2D& pricer, size_t maximum_level) :
+	_pricer(pricer.clone()), _maximum_level(maximum_level)
+{
+}
+
+MultilevelMonteCarloPricer2D::MultilevelMonteCarloPricer2D(const MultilevelMonteCarloPricer2D& pricer) :
+	_pricer(pricer._pricer->clone()), _maximum_level(pricer._maximum_level)
+{
+}
+
+MultilevelMonteCarloPricer2D& MultilevelMonteCarloPricer2D::operator=(const MultilevelMonteCarloPricer2D& pricer)
+{
+	if (!(this == &pricer)) {
+		delete _pricer;
+		_pricer = pricer._pricer->clone();
+		_maximum_level = pricer._maximum_level;
+	}
+	return *this;
+}
+
+MultilevelMonteCarloPricer2D::~MultilevelMonteCarloPricer2D()
+{
+	delete _pricer;
+}
+
+Vector MultilevelMonteCarloPricer2D::levelTimePoints(size_t level) const
+{
+	Vector coarse_time_points = _pricer->getPathSimulator()->getTimePoints();
+	size_t refinement = (size_t)1 << level;
+
+	Vector time_points{ coarse_time_points[0] };
+	for (size_t index = 0; index + 1 < coarse_time_points.size(); ++index) {
+		double time_gap = (coarse_time_points[index + 1] - coarse_time_points[index]) / refinement;
+		for (size_t sub_index = 1; sub_index < refinement; ++sub_index)
+			time_points.push_back(coarse_time_points[index] + sub_index * time_gap);
+		time_points.push_back(coarse_time_points[index + 1]);
+	}
+	return time_points;
+}
+
+MultilevelResult MultilevelMonteCarloPricer2D::price(double target_rmse, size_t number_of_threads, unsigned long long seed) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::unique_ptr<MonteCarloPricer2D>> pricers;
+	std::vector<RunningStatistics> statistics;
+	std::vector<double> seconds;
+	std::vector<size_t> extra_simulations;
+
+	auto addLevel = [&]() {
+		pricers.emplace_back(_pricer->cloneWithTimePoints(levelTimePoints(pricers.size())));
+		statistics.push_back(RunningStatistics());
+		seconds.push_back(0.);
+		extra_simulations.push_back(PILOT_SIMULATIONS);
+	};
+	// Starts with three levels, so that the bias can be estimated from the last two corrections
+	for (size_t level = 0; level <= std::min(_maximum_level, (size_t)2); ++level)
+		addLevel();
+
+	MultilevelResult result;
+	result.converged = false;
+	while (true)
+	{
+		for (size_t level = 0; level < pricers.size(); ++level)
+		{
+			if (extra_simulations[level] == 0)
+				continue;
+			auto level_start = std::chrono::steady_clock::now();
+			// Each level has its own seed, so that the levels are independent
+			statistics[level].merge(pricers[level]->priceCorrection(level > 0 ? pricers[level - 1].get() : nullptr, 2,
+				statistics[level].getCount(), extra_simulations[level], number_of_threads, seed + level));
+			seconds[level] += std::chrono::duration<double>(std::chrono::steady_clock::now() - level_start).count();
+			extra_simulations[level] = 0;
+		}
+
+		// Optimal numbers of paths for a standard error of target_rmse / sqrt(2): N_l proportional to sqrt(V_l / C_l)
+		double sum_sqrt_variance_cost = 0.;
+		for (size_t level = 0; level < pricers.size(); ++level)
+			sum_sqrt_variance_cost += sqrt(statistics[level].getVariance() * seconds[level] / statistics[level].getCount());
+
+		bool enough_simulations = true;
+		for (size_t level = 0; level < pricers.size(); ++level)
+		{
+			double cost = seconds[level] / statistics[level].getCount();
+			double optimal = (cost > 0.) ? 2. / (target_rmse * target_rmse) * sqrt(statistics[level].getVariance() / cost) * sum_sqrt_variance_cost : 0.;
+			size_t count = statistics[level].getCount();
+			if (optimal > 1.01 * count)
+			{
+				size_t extra = (size_t)ceil(optimal) - count;
+				extra_simulations[level] = (extra + SIMULATIONS_GRANULARITY - 1) / SIMULATIONS_GRANULARITY * SIMULATIONS_GRANULARITY;
+				enough_simulations = false;
+			}
+		}
+		if (!enough_simulations)
+			continue;
+
+		// Weak order 1: the remaining bias is about the last correction, the one before giving a second estimate.
+		// Level 0 holds the coarse price, not a correction: without two corrections there is no bias estimate.
+		size_t last = pricers.size() - 1;
+		result.bias = (last < 2) ? std::numeric_limits<double>::infinity()
+			: std::max(fabs(statistics[last].getMean()), 0.5 * fabs(statistics[last - 1].getMean()));
+		if (result.bias <= target_rmse / sqrt(2.))
+		{
+			result.converged = true;
+			break;
+		}
+		if (last >= _maximum_level)
+			break;
+		addLevel();
+	}
+
+	result.price = 0.;
+	double variance_of_price = 0.;
+	for (size_t level = 0; level < pricers.size(); ++level)
+	{
+		MultilevelLevel level_result;
+		level_result.number_of_steps = pricers[level]->getPathSimulator()->getTimePoints().size() - 1;
+		level_result.number_of_simulations = statistics[level].getCount();
+		level_result.mean = statistics[level].getMean();
+		level_result.variance = statistics[level].getVariance();
+		level_result.cost = seconds[level] / statistics[level].getCount();
+		result.levels.push_back(level_result);
+
+		result.price += level_result.mean;
+		variance_of_price += level_result.variance / level_result.number_of_simulations;
+	}
+	result.standard_error = sqrt(variance_of_price);
+	result.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
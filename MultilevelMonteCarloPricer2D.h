@@ -0,0 +1,55 @@
+#ifndef MULTILEVELMONTECARLOPRICER2D_H
+#define MULTILEVELMONTECARLOPRICER2D_H
+
+#include "MonteCarloPricer2D.h"
+
+#include <vector>
+
+// Diagnostics of one level: level 0 estimates the price on the coarsest grid, level l the correction
+// from the grid with 2^(l-1) to the grid with 2^l steps per step of the coarsest grid
+struct MultilevelLevel
+{
+	size_t number_of_steps;
+	size_t number_of_simulations;
+	double mean;
+	double variance;
+	double cost;				// seconds per simulation
+};
+
+struct MultilevelResult
+{
+	double price;
+	double standard_error;		// sqrt(sum of variance / number_of_simulations over the levels)
+	double bias;				// estimated from the corrections of the last levels, the schemas being of weak order 1, infinite below level 2
+	double elapsed_seconds;
+	bool converged;				// false when the maximum level is reached before the bias is small enough (always below level 2)
+	std::vector<MultilevelLevel> levels;
+};
+
+// Multilevel Monte Carlo (Giles, "Multilevel Monte Carlo path simulation"): the price on the finest grid is written as the
+// price on the coarsest grid plus the corrections between successive grids, each estimated with its own paths.
+// The fine and coarse paths of a correction share their Brownian increments, so the corrections have a small variance and
+// need few paths: most of the paths are simulated on the coarse grids.
+// The coarsest grid is the one of the given pricer, its observation dates being kept on every level.
+class MultilevelMonteCarloPricer2D final
+{
+public:
+	MultilevelMonteCarloPricer2D(const MonteCarloPricer2D& pricer, size_t maximum_level);
+	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
+	MultilevelMonteCarloPricer2D(const MultilevelMonteCarloPricer2D& pricer);
+	MultilevelMonteCarloPricer2D& operator=(const MultilevelMonteCarloPricer2D& pricer);
+	~MultilevelMonteCarloPricer2D();
+
+	// Adds levels and paths until the root mean square error (standard error and bias) is below target_rmse:
+	// the paths are shared between the levels so as to minimize the cost, from the variance and the cost measured on each level
+	MultilevelResult price(double target_rmse, size_t number_of_threads, unsigned long long seed) const;
+
+private:
+	// Grid of the given level: each step of the coarsest grid split in 2^level equal steps
+	Vector levelTimePoints(size_t level) const;
+
+	MonteCarloPricer2D* _pricer;
+	size_t _maximum_level;
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "PathAccumulator.h"
+
+#include <cmath>
+
+void PathAccumulator::reset(Pair initial_factors)
+{
+	resetBatch(1, initial_factors);
+}
+
+void PathAccumulator::accumulate(int step_index, Pair factors)
+{
+	double log_spot = log(factors.first);
+	accumulateBatch(step_index, &log_spot, &factors.second);
+}
+
+double PathAccumulator::value() const
+{
+	return batchValue(0);
+}
+
+bool PathAccumulator::needsSpot() const
+{
+	return true;
+}
+
+// Maps each observation time to the closest time point, and gives the annualization factor 1 / (last - first observation)
+static void mapObservations(const Vector& time_points, const Vector& observation_times,
+	std::vector<bool>& is_observation, int& first_observation_index, double& annualization)
+{
+	int last_observation_index = -1;
+	for (double observation_time : observation_times) {
+		int closest_index = 0;
+		for (int index = 1; index < (int)time_points.size(); ++index) {
+			if (fabs(time_points[index] - observation_time) < fabs(time_points[closest_index] - observation_time))
+				closest_index = index;
+		}
+		is_observation[closest_index] = true;
+		if (closest_index < first_observation_index) first_observation_index = closest_index;
+		if (closest_index > last_observation_index) last_observation_index = closest_index;
+	}
+
+	if (last_observation_index > first_observation_index)
+		annualization = 1. / (time_points[last_observation_index] - time_points[first_observation_index]);
+}
+
+RealizedVarianceAccumulator::RealizedVarianceAccumulator(const Vector& time_points) :
+	RealizedVarianceAccumulator(time_points, time_points)
+{
+}
+
+RealizedVarianceAccumulator::RealizedVarianceAccumulator(const Vector& time_points, const Vector& observation_times) :
+	_is_observation(time_points.size(), false), _first_observation_index((int)time_points.size()), _annualization(0.)
+{
+	mapObservations(time_points, observation_times, _is_observation, _first_observation_index, _annualization);
+}
+
+RealizedVarianceAccumulator* RealizedVarianceAccumulator::clone() const
+{
+	return new RealizedVarianceAccumulator(*this);
+}
+
+void RealizedVarianceAccumulator::resetBatch(size_t number_of_paths, Pair initial_factors)
+{
+	_last_log_spots.assign(number_of_paths, log(initial_factors.first));
+	_sums.assign(number_of_paths, 0.);
+}
+
+void RealizedVarianceAccumulator::accumulateBatch(int step_index, const double* log_spots, const double* /*variances*/)
+{
+	if (!_is_observation[step_index])
+		return;
+
+	size_t number_of_paths = _sums.size();
+	// The first observation only fixes the starting point of the first log return
+	if (step_index > _first_observation_index) {
+		for (size_t i = 0; i < number_of_paths; ++i) {
+			double log_return = log_spots[i] - _last_log_spots[i];
+			_sums[i] += log_return * log_return;
+		}
+	}
+	for (size_t i = 0; i < number_of_paths; ++i)
+		_last_log_spots[i] = log_spots[i];
+}
+
+double RealizedVarianceAccumulator::batchValue(size_t path_index) const
+{
+	return _sums[path_index] * _annualization;
+}
+
+CorridorVarianceAccumulator::CorridorVarianceAccumulator(const Vector& time_points, const Vector& observation_times, double lower_barrier, double upper_barrier) :
+	_is_observation(time_points.size(), false), _first_observation_index((int)time_points.size()), _annualization(0.),
+	_log_lower_barrier(log(lower_barrier)), _log_upper_barrier(log(upper_barrier))
+{
+	mapObservations(time_points, observation_times, _is_observation, _first_observation_index, _annualization);
+}
+
+CorridorVarianceAccumulator* CorridorVarianceAccumulator::clone() const
+{
+	return new CorridorVarianceAccumulator(*this);
+}
+
+void CorridorVarianceAccumulator::resetBatch(size_t number_of_paths, Pair initial_factors)
+{
+	_last_log_spots.assign(number_of_paths, log(initial_factors.first));
+	_sums.assign(number_of_paths, 0.);
+}
+
+void CorridorVarianceAccumulator::accumulateBatch(int step_index, const double* log_spots, const double* /*variances*/)
+{
+	if (!_is_observation[step_index])
+		return;
+
+	size_t number_of_paths = _sums.size();
+	if (step_index > _first_observation_index) {
+		for (size_t i = 0; i < number_of_paths; ++i) {
+			double log_return = log_spots[i] - _last_log_spots[i];
+			bool in_corridor = (_last_log_spots[i] >= _log_lower_barrier && _last_log_spots[i] <= _log_upper_barrier);
+			_sums[i] += in_corridor ? log_return * log_return : 0.;
+		}
+	}
+	for (size_t i = 0; i < number_of_paths; ++i)
+		_last_log_spots[i] = log_spots[i];
+}
+
+double CorridorVarianceAccumulator::batchValue(size_t path_index) const
+{
+	return _sums[path_index] * _annualization;
+}
+
+ConditionalRealizedVarianceAccumulator::ConditionalRealizedVarianceAccumulator(const StepPlan& plan, const Vector& time_points, const Vector& observation_times) :
+	_plan(plan), _is_observation(time_points.size(), false), _first_observation_index((int)time_points.size()), _annualization(0.)
+{
+	mapObservations(time_points, observation_times, _is_observation, _first_observation_index, _annualization);
+}
+
+ConditionalRealizedVarianceAccumulator* ConditionalRealizedVarianceAccumulator::clone() const
+{
+	return new ConditionalRealizedVarianceAccumulator(*this);
+}
+
+void ConditionalRealizedVarianceAccumulator::resetBatch(size_t number_of_paths, Pair initial_factors)
+{
+	_last_variances.assign(number_of_paths, initial_factors.second);
+	_means.assign(number_of_paths, 0.);
+	_variances.assign(number_of_paths, 0.);
+	_sums.assign(number_of_paths, 0.);
+}
+
+void ConditionalRealizedVarianceAccumulator::accumulateBatch(int step_index, const double* /*log_spots*/, const double* variances)
+{
+	size_t number_of_paths = _sums.size();
+	const StepCoefficients& step = _plan.getStep(step_index - 1);
+	for (size_t i = 0; i < number_of_paths; ++i) {
+		double v = _last_variances[i];
+		double v_delta = variances[i];
+		_means[i] += step.K0 + step.K1 * v + step.K2 * v_delta;
+		_variances[i] += step.K3 * v + step.K4 * v_delta;
+		_last_variances[i] = v_delta;
+	}
+
+	if (!_is_observation[step_index])
+		return;
+
+	// The first observation only starts the first log return
+	if (step_index > _first_observation_index) {
+		for (size_t i = 0; i < number_of_paths; ++i)
+			_sums[i] += _means[i] * _means[i] + _variances[i];
+	}
+	for (size_t i = 0; i < number_of_paths; ++i) {
+		_means[i] = 0.;
+		_variances[i] = 0.;
+	}
+}
+
+double ConditionalRealizedVarianceAccumulator::batchValue(size_t path_index) const
+{
+	return _sums[path_index] * _annualization;
+}
+
+bool ConditionalRealizedVarianceAccumulator::needsSpot() const
+{
+	return false;
+}
+
+PortfolioAccumulator::PortfolioAccumulator() :
+	_needs_spot(false)
+{
+}
+
+PortfolioAccumulator::PortfolioAccumulator(const PortfolioAccumulator& accumulator) :
+	_needs_spot(accumulator._needs_spot)
+{
+	for (const PathAccumulator* child : accumulator._accumulators)
+		_accumulators.push_back(child->clone());
+}
+
+PortfolioAccumulator& PortfolioAccumulator::operator=(const PortfolioAccumulator& accumulator)
+{
+	if (!(this == &accumulator)) {
+		for (PathAccumulator* child : _accumulators)
+			delete child;
+		_accumulators.clear();
+		for (const PathAccumulator* child : accumulator._accumulators)
+			_accumulators.push_back(child->clone());
+		_needs_spot = accumulator._needs_spot;
+	}
+	return *this;
+}
+
+PortfolioAccumulator::~PortfolioAccumulator()
+{
+	for (PathAccumulator* child : _accumulators)
+		delete child;
+}
+
+PortfolioAccumulator* PortfolioAccumulator::clone() const
+{
+	return new PortfolioAccumulator(*this);
+}
+
+void PortfolioAccumulator::addAccumulator(PathAccumulator* accumulator)
+{
+	_accumulators.push_back(accumulator);
+	_needs_spot = _needs_spot || accumulator->needsSpot();
+}
+
+size_t PortfolioAccumulator::getNumberOfAccumulators() const
+{
+	return _accumulators.size();
+}
+
+const PathAccumulator& PortfolioAccumulator::getAccumulator(size_t index) const
+{
+	return *_accumulators[index];
+}
+
+void PortfolioAccumulator::resetBatch(size_t number_of_paths, Pair initial_factors)
+{
+	for (PathAccumulator* child : _accumulators)
+		child->resetBatch(number_of_paths, initial_factors);
+}
+
+void PortfolioAccumulator::accumulateBatch(int step_index, const double* log_spots, const double* variances)
+{
+	for (PathAccumulator* child : _accumulators)
+		child->accumulateBatch(step_index, log_spots, variances);
+}
+
+double PortfolioAccumulator::batchValue(size_t path_index) const
+{
+	double value = 0.;
+	for (const PathAccumulator* child : _accumulators)
+		value += child->batchValue(path_index);
+	return value;
+}
+
+bool PortfolioAccumulator::needsSpot() const
+{
+	return _needs_spot;
+}
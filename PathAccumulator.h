@@ -0,0 +1,139 @@
+#ifndef PATHACCUMULATOR_H
+#define PATHACCUMULATOR_H
+
+#include "StepPlan.h"
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+using Vector = std::vector<double>;
+using Pair = std::pair<double, double>;
+
+// Receives the factors of the paths step after step, as they are simulated, and only keeps what the payoff needs:
+// no path has to be stored. It works on a batch of paths (arrays of log spots and variances), a single path being a batch of size 1.
+class PathAccumulator
+{
+public:
+	virtual ~PathAccumulator() = default;
+	virtual PathAccumulator* clone() const = 0;
+
+	// Starts number_of_paths new paths at the initial factors (time point 0)
+	virtual void resetBatch(size_t number_of_paths, Pair initial_factors) = 0;
+	// Factors of every path of the batch at time point step_index
+	virtual void accumulateBatch(int step_index, const double* log_spots, const double* variances) = 0;
+	virtual double batchValue(size_t path_index) const = 0;
+	// False when only the variances are read: the simulators then skip the spot, and log_spots is null
+	virtual bool needsSpot() const;
+
+	// Single path versions, the factors being (spot, variance) as in the path simulator
+	void reset(Pair initial_factors);
+	void accumulate(int step_index, Pair factors);
+	double value() const;
+};
+
+// Realized variance of the log returns between consecutive observation dates, annualized:
+// sum of the squared log returns divided by the time between the first and the last observation.
+class RealizedVarianceAccumulator final : public PathAccumulator
+{
+public:
+	// Observation at every time point
+	RealizedVarianceAccumulator(const Vector& time_points);
+	// Each observation time is mapped to the closest time point of the simulation
+	RealizedVarianceAccumulator(const Vector& time_points, const Vector& observation_times);
+	RealizedVarianceAccumulator* clone() const override;
+
+	void resetBatch(size_t number_of_paths, Pair initial_factors) override;
+	void accumulateBatch(int step_index, const double* log_spots, const double* variances) override;
+	double batchValue(size_t path_index) const override;
+
+private:
+	// For each time point, true if it is an observation date
+	std::vector<bool> _is_observation;
+	int _first_observation_index;
+	double _annualization;
+
+	Vector _last_log_spots;
+	Vector _sums;
+};
+
+// Corridor variance: only the log returns starting with a spot in [lower_barrier, upper_barrier] are summed,
+// annualized as the realized variance
+class CorridorVarianceAccumulator final : public PathAccumulator
+{
+public:
+	CorridorVarianceAccumulator(const Vector& time_points, const Vector& observation_times, double lower_barrier, double upper_barrier);
+	CorridorVarianceAccumulator* clone() const override;
+
+	void resetBatch(size_t number_of_paths, Pair initial_factors) override;
+	void accumulateBatch(int step_index, const double* log_spots, const double* variances) override;
+	double batchValue(size_t path_index) const override;
+
+private:
+	std::vector<bool> _is_observation;
+	int _first_observation_index;
+	double _annualization;
+	double _log_lower_barrier;
+	double _log_upper_barrier;
+
+	Vector _last_log_spots;
+	Vector _sums;
+};
+
+// Conditional Monte Carlo version of the realized variance, which only needs the variance path.
+// Given the variances, each log return of the spot schema is normal with mean the sum of K0 + K1 * v + K2 * v_delta
+// and variance the sum of K3 * v + K4 * v_delta over its steps: the squared log return is replaced by its exact
+// conditional expectation, mean^2 + variance. Same expectation as the realized variance, with a smaller variance.
+class ConditionalRealizedVarianceAccumulator final : public PathAccumulator
+{
+public:
+	ConditionalRealizedVarianceAccumulator(const StepPlan& plan, const Vector& time_points, const Vector& observation_times);
+	ConditionalRealizedVarianceAccumulator* clone() const override;
+
+	void resetBatch(size_t number_of_paths, Pair initial_factors) override;
+	void accumulateBatch(int step_index, const double* log_spots, const double* variances) override;
+	double batchValue(size_t path_index) const override;
+	bool needsSpot() const override;
+
+private:
+	StepPlan _plan;
+	std::vector<bool> _is_observation;
+	int _first_observation_index;
+	double _annualization;
+
+	Vector _last_variances;
+	// Conditional mean and variance of the current log return
+	Vector _means;
+	Vector _variances;
+	Vector _sums;
+};
+
+// Several accumulators fed by the same paths, e.g. the contracts of a portfolio on the same underlying
+class PortfolioAccumulator final : public PathAccumulator
+{
+public:
+	PortfolioAccumulator();
+	// Copy constructor, Assignement operator and Destructor are NEEDED because the member variables are POINTERS
+	PortfolioAccumulator(const PortfolioAccumulator& accumulator);
+	PortfolioAccumulator& operator=(const PortfolioAccumulator& accumulator);
+	~PortfolioAccumulator();
+	PortfolioAccumulator* clone() const override;
+
+	// Takes the ownership of the accumulator
+	void addAccumulator(PathAccumulator* accumulator);
+	size_t getNumberOfAccumulators() const;
+	const PathAccumulator& getAccumulator(size_t index) const;
+
+	void resetBatch(size_t number_of_paths, Pair initial_factors) override;
+	void accumulateBatch(int step_index, const double* log_spots, const double* variances) override;
+	// Sum of the values of the accumulators
+	double batchValue(size_t path_index) const override;
+	// The spot is simulated as soon as one of the accumulators needs it
+	bool needsSpot() const override;
+
+private:
+	std::vector<PathAccumulator*> _accumulators;
+	bool _needs_spot;
+};
+
+#endif
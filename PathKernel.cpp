@@ -0,0 +1,44 @@
+#include "PathKernel.h"
+
+#include <typeinfo>
+
+// The exact type is checked, a class derived from schemaQE (like schemaIG) may change the steps
+PathKernel* PathKernel::create(const schema& schema, Pair initial_factors, size_t number_of_steps)
+{
+	if (typeid(schema) == typeid(schemaQE)) {
+		QEVarianceStep variance_step = { static_cast<const schemaQE&>(schema).getPsiC() };
+		return new CompiledPathKernel<QEVarianceStep>(schema, initial_factors, number_of_steps, variance_step);
+	}
+	if (typeid(schema) == typeid(schemaTG)) {
+		TGVarianceStep variance_step = { &static_cast<const schemaTG&>(schema).getGrids() };
+		return new CompiledPathKernel<TGVarianceStep>(schema, initial_factors, number_of_steps, variance_step);
+	}
+	return new SchemaPathKernel(schema, initial_factors, number_of_steps);
+}
+
+SchemaPathKernel::SchemaPathKernel(const schema& schema, Pair initial_factors, size_t number_of_steps) :
+	_schema(&schema), _initial_factors(initial_factors), _number_of_steps(number_of_steps)
+{
+}
+
+void SchemaPathKernel::path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const
+{
+	Pair factors = _initial_factors;
+	accumulator.reset(factors);
+	bool simulate_spot = accumulator.needsSpot();
+
+	for (size_t index = 0; index < _number_of_steps; ++index)
+	{
+		engine.skipTo(path_index, index);
+		double next_variance = _schema->nextStepVolatility((int)index, factors, engine);
+		if (simulate_spot) {
+			factors.first = _schema->nextStepSpot(next_variance, (int)index, factors, engine);
+			factors.second = next_variance;
+			accumulator.accumulate((int)index + 1, factors);
+		}
+		else {
+			factors.second = next_variance;
+			accumulator.accumulateBatch((int)index + 1, nullptr, &factors.second);
+		}
+	}
+}
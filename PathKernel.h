@@ -0,0 +1,125 @@
+#ifndef PATHKERNEL_H
+#define PATHKERNEL_H
+
+#ifndef SCHEMA_H
+#include "Schema.h"
+#endif
+
+#include "PathAccumulator.h"
+#include "RandomEngine.h"
+#include "StepKernels.h"
+
+// Simulation of one path step after step into an accumulator, as PathSimulator2D::path(path_index, engine, accumulator).
+// The kernel is chosen once for the concrete type of the schema by create, so the step loop does not go through the virtual
+// methods of the schema: the variance and spot steps of StepKernels.h are inlined into it. The engine and the accumulator are
+// also resolved once per path: with a PhiloxEngine and a RealizedVarianceAccumulator, the loop has no indirect call.
+class PathKernel
+{
+public:
+	virtual ~PathKernel() = default;
+
+	virtual void path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const = 0;
+
+	// Compiled kernel for schemaQE and schemaTG, generic kernel calling the virtual methods for the other schemas.
+	// The paths start at initial_factors and have number_of_steps steps. The kernel reads the constants of the schema,
+	// which must outlive it.
+	static PathKernel* create(const schema& schema, Pair initial_factors, size_t number_of_steps);
+};
+
+// Kernel of the schemas without a compiled kernel: each step calls the virtual methods of the schema
+class SchemaPathKernel final : public PathKernel
+{
+public:
+	SchemaPathKernel(const schema& schema, Pair initial_factors, size_t number_of_steps);
+
+	void path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const override;
+
+private:
+	const schema* _schema;
+	Pair _initial_factors;
+	size_t _number_of_steps;
+};
+
+// Variance step policies of the compiled kernels
+struct QEVarianceStep
+{
+	double psiC;
+
+	template <class Engine>
+	double operator()(const StepCoefficients& step, double v, Engine& engine) const
+	{
+		return stepVarianceQE(step, psiC, v, engine);
+	}
+};
+
+struct TGVarianceStep
+{
+	const TGGrids* grids;
+
+	template <class Engine>
+	double operator()(const StepCoefficients& step, double v, Engine& engine) const
+	{
+		return stepVarianceTG(step, *grids, v, engine);
+	}
+};
+
+// Path loop for the variance step policy VarianceStep and the trapezoidal spot step.
+// The log spot is carried from step to step, instead of the spot.
+template <class VarianceStep>
+class CompiledPathKernel final : public PathKernel
+{
+public:
+	CompiledPathKernel(const schema& schema, Pair initial_factors, size_t number_of_steps, const VarianceStep& variance_step)
+		: _plan(&schema.getStepPlan()), _number_of_steps(number_of_steps), _initial_factors(initial_factors), _variance_step(variance_step)
+	{
+	}
+
+	void path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const override
+	{
+		PhiloxEngine* philox_engine = dynamic_cast<PhiloxEngine*>(&engine);
+		RealizedVarianceAccumulator* realized_variance = dynamic_cast<RealizedVarianceAccumulator*>(&accumulator);
+		if (philox_engine && realized_variance)
+			simulate(path_index, *philox_engine, *realized_variance);
+		else if (philox_engine)
+			simulate(path_index, *philox_engine, accumulator);
+		else
+			simulate(path_index, engine, accumulator);
+	}
+
+private:
+	template <class Engine, class Accumulator>
+	void simulate(size_t path_index, Engine& engine, Accumulator& accumulator) const
+	{
+		double log_spot = std::log(_initial_factors.first);
+		double variance = _initial_factors.second;
+		accumulator.resetBatch(1, _initial_factors);
+
+		if (accumulator.needsSpot()) {
+			for (size_t index = 0; index < _number_of_steps; ++index)
+			{
+				engine.skipTo(path_index, index);
+				const StepCoefficients& step = _plan->getStep((int)index);
+				double next_variance = _variance_step(step, variance, engine);
+				log_spot = stepLogSpot(step, log_spot, variance, next_variance, engine);
+				variance = next_variance;
+				accumulator.accumulateBatch((int)index + 1, &log_spot, &variance);
+			}
+		}
+		else {
+			// variance only: the spot is never read
+			for (size_t index = 0; index < _number_of_steps; ++index)
+			{
+				engine.skipTo(path_index, index);
+				variance = _variance_step(_plan->getStep((int)index), variance, engine);
+				accumulator.accumulateBatch((int)index + 1, nullptr, &variance);
+			}
+		}
+	}
+
+	const StepPlan* _plan;
+	size_t _number_of_steps;
+	Pair _initial_factors;
+	VarianceStep _variance_step;
+};
+
+#endif
@@ -1,53 +1,106 @@
 #include "PathSimulator2D.h"
 #include "RandomNormalGenerator.h"
 
+// The context of the schema is shared when it was built from the same model and time points, which is the usual case
 PathSimulator2D::PathSimulator2D(Pair initial_factors, 
                 const Vector& time_points, 
                 const Model2D& model,
                 const schema& schema):
-    _initial_factors(initial_factors), _time_points(time_points), _model(model.clone()), _schema(schema.clone())
+    _initial_factors(initial_factors),
+    _context(schema.getContext()->isBuiltFrom(model, time_points) ? schema.getContext() : PricingContext::create(model, time_points)),
+    _schema(schema.clone()),
+    _kernel(PathKernel::create(*_schema, _initial_factors, _context->getTimePoints().size() - 1))
 {
 }
 
 PathSimulator2D::PathSimulator2D(const PathSimulator2D& path_simulator):
-    _initial_factors(path_simulator._initial_factors), _time_points(path_simulator._time_points),
-    _model(path_simulator._model->clone()), _schema(path_simulator._schema->clone())
+    _initial_factors(path_simulator._initial_factors), _context(path_simulator._context),
+    _schema(path_simulator._schema->clone()),
+    _kernel(PathKernel::create(*_schema, _initial_factors, _context->getTimePoints().size() - 1))
 {}
 
 // P2 = P1 equivalent to P2.operator=(P1)
 PathSimulator2D& PathSimulator2D::operator=(const PathSimulator2D& path_simulator){
     // check for "self assignment" and do nothing in that case
 	if (!(this == &path_simulator)){
-		delete _model;								// free the storage pointed to by _model
-		_model = path_simulator._model->clone();	// allocate new memory for the pointer
+		// the kernel reads the schema, so both are replaced
+		delete _kernel;
+		delete _schema;
+		_schema = path_simulator._schema->clone();	// allocate new memory for the pointer
 
 		// assignment for other fields
 		_initial_factors = path_simulator._initial_factors;
-		_time_points = path_simulator._time_points;
+		_context = path_simulator._context;
+		_kernel = PathKernel::create(*_schema, _initial_factors, _context->getTimePoints().size() - 1);
     }
     return *this;								 // return this PathSimulator2D
 }
 
 PathSimulator2D::~PathSimulator2D(){
-    delete _model;
+    delete _kernel;
     delete _schema;
 }
 
 Vector_Pair PathSimulator2D::path() const
 {
 	Vector_Pair path2D{ _initial_factors };
+	path2D.reserve(getTimePoints().size());
 
-	for (int index = 0; index < _time_points.size() - 1; ++index)
+	RandomEngine& engine = RandomNormalGenerator::engine();
+	for (int index = 0; index < getTimePoints().size() - 1; ++index)
 	{
-		path2D.push_back(nextStep(index, path2D[index]));
+		path2D.push_back(nextStep(index, path2D[index], engine));
 	}
 
 	return path2D;
 }
 
-Vector PathSimulator2D::getTimePoints() const
+Vector_Pair PathSimulator2D::path(size_t path_index, RandomEngine& engine) const
 {
-	return _time_points;
+	Vector_Pair path2D(getTimePoints().size());
+	path(path_index, engine, path2D.data());
+	return path2D;
+}
+
+void PathSimulator2D::path(size_t path_index, RandomEngine& engine, Pair* factors) const
+{
+	factors[0] = _initial_factors;
+	for (int index = 0; index < getTimePoints().size() - 1; ++index)
+	{
+		engine.skipTo(path_index, index);
+		factors[index + 1] = nextStep(index, factors[index], engine);
+	}
+}
+
+void PathSimulator2D::path(PathAccumulator& accumulator) const
+{
+	RandomEngine& engine = RandomNormalGenerator::engine();
+	Pair factors = _initial_factors;
+	accumulator.reset(factors);
+	bool simulate_spot = accumulator.needsSpot();
+
+	for (int index = 0; index < getTimePoints().size() - 1; ++index)
+	{
+		if (simulate_spot) {
+			factors = nextStep(index, factors, engine);
+			accumulator.accumulate(index + 1, factors);
+		}
+		else {
+			// variance only: the spot stays at its initial value and is never read
+			factors.second = _schema->nextStepVolatility(index, factors, engine);
+			accumulator.accumulateBatch(index + 1, nullptr, &factors.second);
+		}
+	}
+}
+
+void PathSimulator2D::path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const
+{
+	_kernel->path(path_index, engine, accumulator);
+}
+
+const Vector& PathSimulator2D::getTimePoints() const
+{
+	return _context->getTimePoints();
 }
 
 schema* PathSimulator2D::getSchema() const
@@ -57,19 +110,16 @@ schema* PathSimulator2D::getSchema() const
 
 const Model2D* PathSimulator2D::getModel() const
 {
-    return _model;
+    return _context->getModel();
 }
 
 Pair PathSimulator2D::nextStep(int current_index,
-    Pair current_factors) const {
-
-    double cur_time = _time_points[current_index];
-    double time_gap = _time_points[current_index + 1] - cur_time;
+    Pair current_factors, RandomEngine& engine) const {
 
     Pair nextStep;
 
-    nextStep.second = _schema->nextStepVolatility(current_index, current_factors);
-    nextStep.first = _schema->nextStepSpot(nextStep.second, current_index, current_factors);
+    nextStep.second = _schema->nextStepVolatility(current_index, current_factors, engine);
+    nextStep.first = _schema->nextStepSpot(nextStep.second, current_index, current_factors, engine);
 
     return nextStep;
 
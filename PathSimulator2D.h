@@ -10,6 +10,9 @@
 #include "Schema.h"
 #endif
 
+#include "PathAccumulator.h"
+#include "PathKernel.h"
+
 #include <vector>
 #include <cmath>
 
@@ -24,24 +27,37 @@ public:
                     const Model2D& model,
 					const schema& schema);
 	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER 
+	// (the model and the time points are in the context, shared by the copies)
 	PathSimulator2D(const PathSimulator2D& path_simulator);
 	PathSimulator2D& operator=(const PathSimulator2D& path_simulator);
 	~PathSimulator2D();
 
 
+	// Draws from the engine of the calling thread, where it currently is
 	Vector_Pair path() const;
-	Vector getTimePoints() const;
+	// Draws from the given engine, each step starting at its (path_index, step) coordinate:
+	// the path only depends on the engine seed and on path_index
+	Vector_Pair path(size_t path_index, RandomEngine& engine) const;
+	// Same path written in the caller buffer, which holds getTimePoints().size() factors: nothing is allocated
+	void path(size_t path_index, RandomEngine& engine, Pair* factors) const;
+	// Streaming versions: each step is given to the accumulator as soon as it is simulated, and the path is not stored.
+	// If the accumulator does not need the spot, only the variance is simulated.
+	void path(PathAccumulator& accumulator) const;
+	void path(size_t path_index, RandomEngine& engine, PathAccumulator& accumulator) const;
+	const Vector& getTimePoints() const;
 	schema* getSchema() const;
 	const Model2D* getModel() const;
 
 private:
 	// This method is internal to the class, not needed outside it, so we set it as being private
-	Pair nextStep(int current_index, Pair current_factors) const; 
+	Pair nextStep(int current_index, Pair current_factors, RandomEngine& engine) const; 
 
 	Pair _initial_factors;
-	Vector _time_points;
-	const Model2D* _model;
+	// Model and time points, shared with the schema
+	std::shared_ptr<const PricingContext> _context;
 	schema* _schema;
+	// Path loop compiled for the type of the schema, created once with it
+	PathKernel* _kernel;
 
 };
 
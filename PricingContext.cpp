@@ -0,0 +1,42 @@
+#include "PricingContext.h"
+
+PricingContext::PricingContext(const Model2D& model, const Vector& time_points) :
+	_model(model.clone()), _time_points(time_points), _plan(model, time_points)
+{
+}
+
+PricingContext::~PricingContext()
+{
+	delete _model;
+}
+
+std::shared_ptr<const PricingContext> PricingContext::create(const Model2D& model, const Vector& time_points)
+{
+	return std::make_shared<const PricingContext>(model, time_points);
+}
+
+const Model2D* PricingContext::getModel() const
+{
+	return _model;
+}
+
+const Vector& PricingContext::getTimePoints() const
+{
+	return _time_points;
+}
+
+const StepPlan& PricingContext::getStepPlan() const
+{
+	return _plan;
+}
+
+bool PricingContext::isBuiltFrom(const Model2D& model, const Vector& time_points) const
+{
+	if (&model != _model && (model.get_drift() != _model->get_drift()
+		|| model.get_mean_reversion_speed() != _model->get_mean_reversion_speed()
+		|| model.get_mean_reversion_level() != _model->get_mean_reversion_level()
+		|| model.get_vol_of_vol() != _model->get_vol_of_vol()
+		|| model.get_correlation() != _model->get_correlation()))
+		return false;
+	return &time_points == &_time_points || time_points == _time_points;
+}
@@ -0,0 +1,42 @@
+#ifndef PRICINGCONTEXT_H
+#define PRICINGCONTEXT_H
+
+#ifndef MODEL2D_H
+#include "Model2D.h"
+#endif
+
+#include "StepPlan.h"
+
+#include <memory>
+#include <vector>
+
+using Vector = std::vector<double>;
+
+// Immutable data of a (model, time grid): the model, the time points and the constants of every step.
+// It never changes once built, so one object is shared (std::shared_ptr<const PricingContext>) by the schemas and the path
+// simulators built on it, in every thread: copying them only copies the pointer.
+class PricingContext final
+{
+public:
+	PricingContext(const Model2D& model, const Vector& time_points);
+	// The context is shared, never copied
+	PricingContext(const PricingContext& context) = delete;
+	PricingContext& operator=(const PricingContext& context) = delete;
+	~PricingContext();
+
+	static std::shared_ptr<const PricingContext> create(const Model2D& model, const Vector& time_points);
+
+	const Model2D* getModel() const;
+	const Vector& getTimePoints() const;
+	const StepPlan& getStepPlan() const;
+
+	// True if the context was built from a model with the same parameters and from the same time points
+	bool isBuiltFrom(const Model2D& model, const Vector& time_points) const;
+
+private:
+	const Model2D* _model;
+	Vector _time_points;
+	StepPlan _plan;
+};
+
+#endif
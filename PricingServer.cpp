@@ -0,0 +1,338 @@
+#include "PricingServer.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+PricingServer::Connection::Connection(int descriptor) :
+	descriptor(descriptor)
+{
+}
+
+PricingServer::Connection::~Connection()
+{
+	close(descriptor);
+}
+
+void PricingServer::Connection::send(const std::string& line)
+{
+	std::lock_guard<std::mutex> lock(write_mutex);
+	size_t written = 0;
+	while (written < line.size())
+	{
+		// MSG_NOSIGNAL: a client gone is not a reason to kill the server
+		ssize_t result = ::send(descriptor, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+		if (result <= 0)
+			return;
+		written += (size_t)result;
+	}
+}
+
+PricingServer::PricingServer(const PricingServerSettings& settings) :
+	_settings(settings), _pool(settings.number_of_threads), _stopping(false), _draining(false), _listen_descriptor(-1),
+	_number_of_model_uses(0), _number_of_connections(0), _number_of_requests(0)
+{
+	_latencies.reserve(LATENCY_HISTORY_SIZE);
+}
+
+PricingServer::~PricingServer()
+{
+	stop();
+}
+
+bool PricingServer::run(const std::string& socket_path)
+{
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path too long: " << socket_path << "\n";
+		return false;
+	}
+	std::strcpy(address.sun_path, socket_path.c_str());
+
+	// A stale socket of a previous server is removed, anything else at the path is left alone
+	struct stat status;
+	if (lstat(socket_path.c_str(), &status) == 0) {
+		bool stale = false;
+		if (S_ISSOCK(status.st_mode)) {
+			int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+			stale = probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) != 0 && errno == ECONNREFUSED;
+			if (probe >= 0)
+				close(probe);
+		}
+		if (!stale) {
+			std::cerr << "Cannot listen on " << socket_path << ": the path exists and is not a stale socket\n";
+			return false;
+		}
+		unlink(socket_path.c_str());
+	}
+
+	int listen_descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_descriptor < 0 || bind(listen_descriptor, (sockaddr*)&address, sizeof(address)) != 0
+		|| listen(listen_descriptor, 64) != 0) {
+		std::cerr << "Cannot listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+		if (listen_descriptor >= 0)
+			close(listen_descriptor);
+		return false;
+	}
+	_listen_descriptor = listen_descriptor;
+	// A stop before the descriptor was published could not wake up accept
+	if (_stopping)
+		shutdown(listen_descriptor, SHUT_RDWR);
+
+	std::cerr << "Listening on " << socket_path << "\n";
+	std::thread dispatcher(&PricingServer::dispatch, this);
+	while (!_stopping)
+	{
+		int descriptor = accept(listen_descriptor, nullptr, nullptr);
+		if (descriptor < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			// Out of descriptors or memory: waits for some to be released instead of spinning
+			if (!_stopping && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			if (!_stopping)
+				std::cerr << "Cannot accept on " << socket_path << ": " << std::strerror(errno) << "\n";
+			_stopping = true;
+			break;
+		}
+		std::shared_ptr<Connection> connection = std::make_shared<Connection>(descriptor);
+		{
+			std::lock_guard<std::mutex> lock(_connections_mutex);
+			_connections.erase(std::remove_if(_connections.begin(), _connections.end(),
+				[](const std::weak_ptr<Connection>& open_connection) { return open_connection.expired(); }), _connections.end());
+			_connections.push_back(connection);
+			++_number_of_connections;
+		}
+		std::thread(&PricingServer::serve, this, connection).detach();
+	}
+
+	// The clients can not send anything more, but the requests already received are answered
+	{
+		std::unique_lock<std::mutex> lock(_connections_mutex);
+		for (const std::weak_ptr<Connection>& open_connection : _connections)
+			if (std::shared_ptr<Connection> connection = open_connection.lock())
+				shutdown(connection->descriptor, SHUT_RD);
+		_connections_closed.wait(lock, [this] { return _number_of_connections == 0; });
+	}
+	{
+		std::lock_guard<std::mutex> lock(_pending_mutex);
+		_draining = true;
+	}
+	_request_available.notify_all();
+	dispatcher.join();
+	_pool.wait();
+
+	_listen_descriptor = -1;
+	close(listen_descriptor);
+	unlink(socket_path.c_str());
+	return true;
+}
+
+void PricingServer::stop()
+{
+	_stopping = true;
+	// Wakes up accept
+	int listen_descriptor = _listen_descriptor;
+	if (listen_descriptor >= 0)
+		shutdown(listen_descriptor, SHUT_RDWR);
+	_request_available.notify_all();
+}
+
+void PricingServer::serve(std::shared_ptr<Connection> connection)
+{
+	std::string buffer;
+	char chunk[4096];
+	while (!_stopping)
+	{
+		ssize_t size = recv(connection->descriptor, chunk, sizeof(chunk), 0);
+		if (size <= 0)
+			break;
+		buffer.append(chunk, (size_t)size);
+
+		size_t start = 0;
+		for (size_t end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', start))
+		{
+			std::string line = buffer.substr(start, end - start);
+			start = end + 1;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.empty())
+				continue;
+
+			Request request;
+			if (line == "stats") {
+				LatencyStatistics statistics = getLatencyStatistics();
+				std::ostringstream answer;
+				answer << "stats," << statistics.number_of_requests << "," << 1000. * statistics.median << ","
+					<< 1000. * statistics.percentile_90 << "," << 1000. * statistics.percentile_99 << "," << 1000. * statistics.maximum << "\n";
+				connection->send(answer.str());
+			}
+			else if (line == "shutdown")
+				stop();
+			else if (parseTrade(line, request.trade)) {
+				request.line = line;
+				request.connection = connection;
+				request.arrival = Clock::now();
+				submit(std::move(request));
+			}
+			else
+				connection->send("error," + line + "\n");
+		}
+		buffer.erase(0, start);
+	}
+
+	connection.reset();
+	std::lock_guard<std::mutex> lock(_connections_mutex);
+	if (--_number_of_connections == 0)
+		_connections_closed.notify_all();
+}
+
+void PricingServer::submit(Request&& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(_pending_mutex);
+		_pending_requests[request.trade].push_back(std::move(request));
+	}
+	_request_available.notify_one();
+}
+
+void PricingServer::dispatch()
+{
+	std::chrono::duration<double> batching_window(_settings.batching_window);
+	while (true)
+	{
+		std::map<Trade, std::vector<Request>, TradeGroupLess> batches;
+		{
+			std::unique_lock<std::mutex> lock(_pending_mutex);
+			// After stop, the connections still open may send requests: the dispatcher goes on until they are all closed
+			_request_available.wait(lock, [this] { return !_pending_requests.empty() || _draining; });
+			if (_pending_requests.empty())
+				return;
+			// The requests arriving during the window join the batch
+			if (!_stopping) {
+				lock.unlock();
+				std::this_thread::sleep_for(batching_window);
+				lock.lock();
+			}
+			batches.swap(_pending_requests);
+		}
+
+		for (auto& key_and_requests : batches)
+		{
+			std::vector<Request>& requests = key_and_requests.second;
+			for (size_t first = 0; first < requests.size(); first += _settings.maximum_group_size)
+			{
+				size_t last = std::min(first + _settings.maximum_group_size, requests.size());
+				std::vector<Request> group(std::make_move_iterator(requests.begin() + first), std::make_move_iterator(requests.begin() + last));
+				_pool.submit([this, group = std::move(group)]() { priceBatch(group); });
+			}
+		}
+	}
+}
+
+void PricingServer::priceBatch(const std::vector<Request>& requests)
+{
+	std::vector<Trade> trades(requests.size());
+	for (size_t request_index = 0; request_index < requests.size(); ++request_index)
+		trades[request_index] = requests[request_index].trade;
+
+	std::vector<TradeResult> results;
+	try {
+		std::shared_ptr<const TradeGroupModel> model = getModel(trades[0]);
+		results = priceTradeGroup(*model, trades, _settings.number_of_simulations, _settings.seed);
+	}
+	catch (const std::exception& exception) {
+		std::cerr << "Batch of " << trades.size() << " requests on " << trades[0].underlying << " failed: " << exception.what() << "\n";
+	}
+
+	for (size_t request_index = 0; request_index < requests.size(); ++request_index)
+	{
+		std::ostringstream answer;
+		if (results.size() == requests.size()) {
+			const TradeResult& result = results[request_index];
+			answer.precision(10);
+			answer << result.id << "," << result.price << "," << result.standard_error << "," << result.fair_strike << "\n";
+		}
+		else
+			answer << "error," << requests[request_index].line << "\n";
+		requests[request_index].connection->send(answer.str());
+		recordLatency(std::chrono::duration<double>(Clock::now() - requests[request_index].arrival).count());
+	}
+}
+
+std::shared_ptr<const TradeGroupModel> PricingServer::getModel(const Trade& trade)
+{
+	{
+		std::lock_guard<std::mutex> lock(_cache_mutex);
+		auto cached = _models.find(trade);
+		if (cached != _models.end()) {
+			cached->second.last_use = ++_number_of_model_uses;
+			return cached->second.model;
+		}
+	}
+
+	// Built outside the lock: two threads may build the same model, the first one inserted is kept
+	std::shared_ptr<const TradeGroupModel> model = std::make_shared<const TradeGroupModel>(trade);
+
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	CachedModel& cached = _models.insert({ trade, { model, 0 } }).first->second;
+	cached.last_use = ++_number_of_model_uses;
+	model = cached.model;
+	if (_models.size() > _settings.maximum_cached_models) {
+		auto least_recently_used = std::min_element(_models.begin(), _models.end(),
+			[](const std::pair<const Trade, CachedModel>& entry, const std::pair<const Trade, CachedModel>& other_entry) {
+				return entry.second.last_use < other_entry.second.last_use; });
+		_models.erase(least_recently_used);
+	}
+	return model;
+}
+
+void PricingServer::recordLatency(double latency)
+{
+	std::lock_guard<std::mutex> lock(_latency_mutex);
+	if (_latencies.size() < LATENCY_HISTORY_SIZE)
+		_latencies.push_back(latency);
+	else
+		_latencies[_number_of_requests % LATENCY_HISTORY_SIZE] = latency;
+	++_number_of_requests;
+}
+
+LatencyStatistics PricingServer::getLatencyStatistics() const
+{
+	std::vector<double> latencies;
+	LatencyStatistics statistics = { 0, 0., 0., 0., 0. };
+	{
+		std::lock_guard<std::mutex> lock(_latency_mutex);
+		latencies = _latencies;
+		statistics.number_of_requests = _number_of_requests;
+	}
+	if (latencies.empty())
+		return statistics;
+
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&latencies](double level) {
+		return latencies[std::min(latencies.size() - 1, (size_t)(level * (double)latencies.size()))];
+	};
+	statistics.median = percentile(0.5);
+	statistics.percentile_90 = percentile(0.9);
+	statistics.percentile_99 = percentile(0.99);
+	statistics.maximum = latencies.back();
+	return statistics;
+}
+
+#endif
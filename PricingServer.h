@@ -0,0 +1,132 @@
+#ifndef PRICINGSERVER_H
+#define PRICINGSERVER_H
+
+// Unix domain sockets: the server is not built on Windows
+#ifndef _WIN32
+
+#include "BatchPricer.h"
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PricingServerSettings
+{
+	size_t number_of_simulations;
+	unsigned long long seed;
+	size_t number_of_threads;			// 0 means one per core
+	size_t maximum_group_size;			// requests priced together on the same paths
+	double batching_window;				// seconds during which the requests are collected before being priced
+	size_t maximum_cached_models;
+};
+
+// Latencies of the requests answered, in seconds, over the last requests
+struct LatencyStatistics
+{
+	size_t number_of_requests;			// since the start of the server
+	double median;
+	double percentile_90;
+	double percentile_99;
+	double maximum;
+};
+
+// Long-running pricer listening on a Unix domain socket. The protocol is made of lines:
+// - a trade in the CSV format of TradeReader (without header) is answered, once priced, by id,price,standard_error,fair_strike
+//   (the answers of a connection come in the order their batch is priced, not always in the order of the requests);
+// - an invalid trade (see isValidTrade), or one whose pricing fails, is answered by error,<the line>;
+// - "stats" is answered by stats,<number of requests>,<median>,<90%>,<99%>,<maximum>, the latencies in milliseconds;
+// - "shutdown" stops the server.
+// The models of the groups (TradeGroupModel: schema, step constants and fair strike) are cached between the requests, and the
+// requests for the same group arriving within the batching window, from any connection, are priced on the same paths.
+// Every batch uses the paths of the same seed, so the answer to a trade does not depend on the requests it was batched with.
+class PricingServer final
+{
+public:
+	PricingServer(const PricingServerSettings& settings);
+	// Copy is not possible (threads and socket)
+	PricingServer(const PricingServer&) = delete;
+	PricingServer& operator=(const PricingServer&) = delete;
+	~PricingServer();
+
+	// Listens on the socket until a shutdown request, false if the socket cannot be opened. An existing file at the path is only
+	// replaced if it is a socket no server listens on.
+	bool run(const std::string& socket_path);
+	void stop();
+
+	LatencyStatistics getLatencyStatistics() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Socket of a client, closed once the connection is over and every answer is written
+	struct Connection
+	{
+		Connection(int descriptor);
+		~Connection();
+		void send(const std::string& line);
+
+		int descriptor;
+		std::mutex write_mutex;
+	};
+
+	struct Request
+	{
+		std::string line;
+		Trade trade;
+		std::shared_ptr<Connection> connection;
+		Clock::time_point arrival;
+	};
+
+	struct CachedModel
+	{
+		std::shared_ptr<const TradeGroupModel> model;
+		size_t last_use;
+	};
+
+	void serve(std::shared_ptr<Connection> connection);
+	void submit(Request&& request);
+	void dispatch();
+	void priceBatch(const std::vector<Request>& requests);
+	std::shared_ptr<const TradeGroupModel> getModel(const Trade& trade);
+	void recordLatency(double latency);
+
+	PricingServerSettings _settings;
+	WorkStealingPool _pool;
+	std::atomic<bool> _stopping;
+	// Set once every connection is closed: no request can arrive anymore, the dispatcher ends when the pending ones are sent
+	std::atomic<bool> _draining;
+	// Read by stop, from the connection thread receiving the shutdown request
+	std::atomic<int> _listen_descriptor;
+
+	// Requests waiting for the dispatcher, by group
+	std::mutex _pending_mutex;
+	std::condition_variable _request_available;
+	std::map<Trade, std::vector<Request>, TradeGroupLess> _pending_requests;
+
+	std::mutex _cache_mutex;
+	std::map<Trade, CachedModel, TradeGroupLess> _models;
+	size_t _number_of_model_uses;
+
+	// Open connections, each served by a detached thread
+	std::mutex _connections_mutex;
+	std::condition_variable _connections_closed;
+	std::vector<std::weak_ptr<Connection>> _connections;
+	size_t _number_of_connections;
+
+	// Circular buffer of the last latencies
+	static const size_t LATENCY_HISTORY_SIZE = 16384;
+	mutable std::mutex _latency_mutex;
+	std::vector<double> _latencies;
+	size_t _number_of_requests;
+};
+
+#endif
+
+#endif
@@ -1,19 +1,28 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "MonteCarloPricer2D.h"
+#include "MultilevelMonteCarloPricer2D.h"
 #include "Schema.h"
 #include "FunctionFairPrice.h"
-#include <time.h>
+#include "HestonCalibrator.h"
+#include "BatchPricer.h"
+#ifndef _WIN32
+#include "PricingServer.h"
+#endif
+#include "TradeFile.h"
+#include "RandomNormalGenerator.h"
 
 using Vector = std::vector<double>;
 using Pair = std::pair<double, double>;
 
-
-std::vector<double> create_discretization_time_points()
+std::vector<double> create_discretization_time_points(size_t number_time_points = 365)
 {
 	Vector time_points;
-	size_t number_time_points = 365.;
 	double maturity = 1.;
 
 	for (size_t time_index = 0; time_index < number_time_points; ++time_index)
@@ -39,14 +48,14 @@ HestonModel create_heston_model() {
 }
 
 
-PathSimulator2D create_pathsimulator_heston_schemaQE()
+PathSimulator2D create_pathsimulator_heston_schemaQE(size_t number_time_points = 365)
 {
 	Pair initial_factors(10., 0.04);
 	double psiC = 1.5;
 	HestonModel model_Heston = create_heston_model();
 
 	// Defines the discretization of time space
-	Vector time_points = create_discretization_time_points();
+	Vector time_points = create_discretization_time_points(number_time_points);
 
 	// Defines the path simulator
 	schemaQE schemaqe(initial_factors,
@@ -87,7 +96,26 @@ PathSimulator2D create_pathsimulator_heston_schemaTG()
 }
 
 
-double get_fair_strike(schema* schema, double h, double rate) {
+// Large steps: the integrated variance is sampled, so a monthly grid is enough
+PathSimulator2D create_pathsimulator_heston_schemaIG(size_t number_time_points = 13)
+{
+	Pair initial_factors(10., 0.04);
+	double psiC = 1.5;
+	HestonModel model_Heston = create_heston_model();
+
+	Vector time_points = create_discretization_time_points(number_time_points);
+
+	schemaIG schemaig(initial_factors,
+		time_points,
+		psiC,
+		model_Heston);
+
+	PathSimulator2D path_simulator_Heston(initial_factors, time_points, model_Heston, schemaig);
+	return path_simulator_Heston;
+}
+
+
+double get_fair_strike(schema* schema, double rate) {
 	const Model2D* model = schema->getModel();
 
 	Pair initial_factors = schema->getInitialFactors();
@@ -97,7 +125,7 @@ double get_fair_strike(schema* schema, double h, double rate) {
 	double vol_of_vol = model->get_vol_of_vol();
 	double correlation = model->get_correlation();
 
-	FairPriceFunction fair_price(h, rate, *schema);
+	FairPriceFunction fair_price(rate, *schema);
 	return fair_price.getFairPrice();
 }
 
@@ -105,7 +133,6 @@ double get_fair_strike(schema* schema, double h, double rate) {
 void testing_pricer_2D()
 {
 	size_t number_of_simulations = 2E2;
-	double h = 1E-3;
 	double rate = 0.;
 
 	PathSimulator2D path_simulator_Heston_QE = create_pathsimulator_heston_schemaQE();
@@ -114,9 +141,38 @@ void testing_pricer_2D()
 	schema* schemaQE_get = path_simulator_Heston_QE.getSchema();
 	schema* schemaTG_get = path_simulator_Heston_TG.getSchema();
 
-	double strike = get_fair_strike(schemaQE_get, h, rate);
+	double strike = get_fair_strike(schemaQE_get, rate);
 	bool isCall = true;
 
+	// Term structure of the fair strikes, from one week to the maturity of the schedule, in one pass
+	FairPriceFunction fair_price_term_structure(rate, *schemaQE_get);
+	Vector maturities = { 7. / 365., 1. / 12., 0.25, 0.5, 1. };
+	Vector fair_strikes = fair_price_term_structure.getFairPrices(maturities);
+	for (size_t maturity_index = 0; maturity_index < maturities.size(); ++maturity_index)
+		std::cout << "Fair strike for maturity " << maturities[maturity_index] << ": " << fair_strikes[maturity_index] << "\n";
+	std::cout << "\n";
+
+	// Batch of fair strikes over several vol of vol, the other parameters being those of the model
+	Vector correlations(5, 0.5), drifts(5, 0.), mean_reversion_speeds(5, 0.5), mean_reversion_levels(5, 0.04), initial_variances(5, 0.04);
+	Vector vols_of_vol = { 0.2, 0.4, 0.6, 0.8, 1. };
+	HestonParameterBatch parameter_batch = { vols_of_vol.size(), correlations.data(), drifts.data(), mean_reversion_speeds.data(),
+		mean_reversion_levels.data(), vols_of_vol.data(), initial_variances.data() };
+	Vector batch_fair_strikes(vols_of_vol.size());
+	getFairPricesBatch(parameter_batch, schemaQE_get->getTimePoints(), batch_fair_strikes.data());
+	for (size_t parameter_index = 0; parameter_index < vols_of_vol.size(); ++parameter_index)
+		std::cout << "Fair strike for vol of vol " << vols_of_vol[parameter_index] << ": " << batch_fair_strikes[parameter_index] << "\n";
+	std::cout << "\n";
+
+	// Calibration to the term structure of fair strikes above: the model violates the Feller condition, so the calibrated
+	// parameters satisfying it differ, with a small error on the strikes
+	HestonCalibrator calibrator(schemaQE_get->getTimePoints(), maturities, fair_strikes, 0.);
+	HestonCalibrationResult calibration = calibrator.calibrate(8, 0, 20240101);
+	std::cout << "Calibrated kappa " << calibration.parameters.mean_reversion_speed << ", theta " << calibration.parameters.mean_reversion_level
+		<< ", sigma " << calibration.parameters.vol_of_vol << ", rho " << calibration.parameters.correlation
+		<< ", v0 " << calibration.parameters.initial_variance << " (rms error " << calibration.root_mean_square_error
+		<< ", " << calibration.number_of_iterations << " iterations)\n";
+	std::cout << "\n";
+
 	MonteCarloVarianceSwapPricer2D* pricer_Heston_SchemaQE = new MonteCarloVarianceSwapPricer2D(path_simulator_Heston_QE, number_of_simulations, rate, strike, isCall);
 	MonteCarloVarianceSwapPricer2D* pricer_Heston_SchemaTG = new MonteCarloVarianceSwapPricer2D(path_simulator_Heston_TG, number_of_simulations, rate, strike, isCall);
 
@@ -152,12 +208,242 @@ void testing_pricer_2D()
 
 	std::cout << "\n";
 
+	// Testing the parallel pricing: same seed, so the same price whatever the number of threads
+	unsigned long long seed = 42;
+	for (size_t number_of_threads = 1; number_of_threads <= 4; number_of_threads *= 2)
+	{
+		double pv_varianceSwapQE = pricer_Heston_SchemaQE->price(number_of_threads, seed);
+		std::cout << "Variance Swap with Heston model and schema QE on " << number_of_threads << " thread(s) is " << pv_varianceSwapQE << "\n";
+	}
+
+	std::cout << "\n";
+
+	// Testing the control variate on a capped variance swap, the control being the realized variance whose expectation is the analytical strike
+	double cap = 2.5 * strike;
+	MonteCarloCappedVarianceSwapPricer2D pricer_capped(path_simulator_Heston_QE, 10 * number_of_simulations, rate, strike, isCall, cap);
+	ControlVariateResult result = pricer_capped.priceWithControlVariate(strike, 0, seed);
+	std::cout << "Capped Variance Swap with schema QE: " << result.plain_price << " (std error " << result.plain_standard_error << ")\n";
+	std::cout << "With the control variate: " << result.price << " (std error " << result.standard_error
+		<< ", variance reduction " << result.variance_reduction << ")\n";
+
+	std::cout << "\n";
+
+	// Testing the randomized quasi Monte Carlo: 16 Sobol replicates of the simulations, to be compared to the fair strike
+	QuasiMonteCarloResult qmc_result = pricer_Heston_SchemaQE->priceQuasiMonteCarlo(16, 0, seed);
+	std::cout << "Variance Swap with schema QE and Sobol points: " << qmc_result.price << " (std error " << qmc_result.standard_error << ")\n";
+
+	std::cout << "\n";
+
+	// Testing the variance reduction options, on batches of paths
+	MonteCarloVarianceSwapPricer2D pricer_batches(path_simulator_Heston_QE, 50 * number_of_simulations, rate, strike, isCall);
+	for (int option = 0; option < 3; ++option)
+	{
+		bool antithetic = (option >= 1), moment_matching = (option == 2);
+		VarianceReductionResult reduction_result = pricer_batches.priceWithVarianceReduction(antithetic, moment_matching, 0, seed);
+		std::cout << "Variance Swap with schema QE" << (antithetic ? ", antithetic" : "") << (moment_matching ? ", moment matching" : "") << ": "
+			<< reduction_result.price << " (std error " << reduction_result.standard_error << ", variance ratio " << reduction_result.variance_ratio << ")\n";
+	}
+
+	std::cout << "\n";
+
+	// Testing the conditional Monte Carlo: variance path only, against the full simulation with the same paths
+	MonteCarloVarianceSwapPricer2D pricer_conditional(path_simulator_Heston_QE, 50 * number_of_simulations, rate, strike, isCall);
+	pricer_conditional.setConditionalMonteCarlo(true);
+	VarianceReductionResult conditional_result = pricer_conditional.priceWithVarianceReduction(false, false, 0, seed);
+	std::cout << "Variance Swap with schema QE, conditional Monte Carlo: " << conditional_result.price
+		<< " (std error " << conditional_result.standard_error << ")\n";
+
+	std::cout << "\n";
+
+	// Testing the large step schema on a monthly grid, against QE on the same grid (the strike is the analytical one for monthly observations)
+	PathSimulator2D path_simulator_Heston_QE_monthly = create_pathsimulator_heston_schemaQE(13);
+	PathSimulator2D path_simulator_Heston_IG_monthly = create_pathsimulator_heston_schemaIG(13);
+	double monthly_strike = get_fair_strike(path_simulator_Heston_IG_monthly.getSchema(), rate);
+	MonteCarloVarianceSwapPricer2D pricer_QE_monthly(path_simulator_Heston_QE_monthly, 1000 * number_of_simulations, rate, monthly_strike, isCall);
+	MonteCarloVarianceSwapPricer2D pricer_IG_monthly(path_simulator_Heston_IG_monthly, 1000 * number_of_simulations, rate, monthly_strike, isCall);
+	AdaptivePricingResult monthly_QE = pricer_QE_monthly.priceAdaptive(1e-4, 10., 0, seed);
+	AdaptivePricingResult monthly_IG = pricer_IG_monthly.priceAdaptive(1e-4, 10., 0, seed);
+	std::cout << "Monthly Variance Swap (strike " << monthly_strike << "), 12 steps, schema QE: " << monthly_QE.price
+		<< " (std error " << monthly_QE.standard_error << ")\n";
+	std::cout << "Monthly Variance Swap (strike " << monthly_strike << "), 12 steps, schema IG: " << monthly_IG.price
+		<< " (std error " << monthly_IG.standard_error << ")\n";
+
+	std::cout << "\n";
+
+	// Testing the multilevel Monte Carlo: monthly grid refined up to 2^6 steps per month, for a target RMSE of 2e-4
+	MonteCarloCappedVarianceSwapPricer2D pricer_capped_monthly(path_simulator_Heston_QE_monthly, number_of_simulations, rate, monthly_strike, isCall, cap);
+	MultilevelMonteCarloPricer2D multilevel_pricer(pricer_capped_monthly, 6);
+	MultilevelResult multilevel_result = multilevel_pricer.price(2e-4, 0, seed);
+	std::cout << "Capped Variance Swap with schema QE, multilevel: " << multilevel_result.price << " (std error " << multilevel_result.standard_error
+		<< ", bias " << multilevel_result.bias << ", " << multilevel_result.elapsed_seconds << "s" << (multilevel_result.converged ? "" : ", not converged") << ")\n";
+	for (const MultilevelLevel& level : multilevel_result.levels)
+		std::cout << "    " << level.number_of_steps << " steps: " << level.number_of_simulations << " paths, mean " << level.mean
+			<< ", variance " << level.variance << ", cost " << level.cost << "s per path\n";
+
+	std::cout << "\n";
+
+	// Testing the portfolio pricing: a strike ladder of calls and puts, a volatility swap, a capped and a corridor variance swap,
+	// all priced on the same paths
+	MonteCarloPortfolioPricer2D portfolio_pricer(path_simulator_Heston_QE, 10 * number_of_simulations);
+	for (double strike_factor : { 0.8, 1., 1.2 })
+	{
+		portfolio_pricer.addContract(MonteCarloVarianceSwapPricer2D(path_simulator_Heston_QE, 0, rate, strike_factor * strike, true));
+		portfolio_pricer.addContract(MonteCarloVarianceSwapPricer2D(path_simulator_Heston_QE, 0, rate, strike_factor * strike, false));
+	}
+	portfolio_pricer.addContract(MonteCarloVolatilitySwapPricer2D(path_simulator_Heston_QE, 0, rate, sqrt(strike), true));
+	portfolio_pricer.addContract(MonteCarloCappedVarianceSwapPricer2D(path_simulator_Heston_QE, 0, rate, strike, isCall, cap));
+	portfolio_pricer.addContract(MonteCarloCorridorVarianceSwapPricer2D(path_simulator_Heston_QE, 0, rate, strike, isCall, 8., 12.));
+	std::vector<ContractPrice> contract_prices = portfolio_pricer.priceContracts(0, seed);
+	for (size_t contract_index = 0; contract_index < contract_prices.size(); ++contract_index)
+		std::cout << "Contract " << contract_index << " of the portfolio: " << contract_prices[contract_index].price
+			<< " (std error " << contract_prices[contract_index].standard_error << ")\n";
+
+	std::cout << "\n";
+
+	// Testing the adaptive pricing: as many paths as needed for a standard error of 5e-4, within 10 seconds
+	MonteCarloVarianceSwapPricer2D pricer_adaptive(path_simulator_Heston_QE, 1000 * number_of_simulations, rate, strike, isCall);
+	AdaptivePricingResult adaptive_result = pricer_adaptive.priceAdaptive(5e-4, 10., 0, seed);
+	std::cout << "Adaptive Variance Swap with schema QE: " << adaptive_result.price << " (std error " << adaptive_result.standard_error
+		<< ", 95% interval [" << adaptive_result.confidence_lower << ", " << adaptive_result.confidence_upper << "], "
+		<< adaptive_result.number_of_simulations << " paths in " << adaptive_result.elapsed_seconds << "s"
+		<< (adaptive_result.converged ? "" : ", not converged") << ")\n";
+
+	std::cout << "\n";
+
+}
+
+
+
+void print_usage()
+{
+	std::cerr << "Usage:\n"
+		<< "  ProjetVarSwapPricing                                 runs the demo\n"
+		<< "  ProjetVarSwapPricing --batch <trades> [--output <file>] [--threads <n>] [--simulations <n>] [--seed <s>] [--group-size <n>]\n"
+		<< "                                                       prices a trade file (CSV or binary, see TradeFile.h)\n"
+		<< "  ProjetVarSwapPricing --convert <trades> <binary file> converts a trade file to the binary format\n"
+#ifndef _WIN32
+		<< "  ProjetVarSwapPricing --serve <socket> [--threads <n>] [--simulations <n>] [--seed <s>] [--window <ms>]\n"
+		<< "                                                       prices the trades sent on a Unix socket (see PricingServer.h)\n"
+#endif
+		;
+}
+
+// Batch pricing of a trade file, the results going to the output file or to the standard output
+int run_batch(int argc, char** argv)
+{
+	std::string trade_file_name = argv[2];
+	std::string output_file_name;
+	BatchPricingSettings settings = { 10000, 20240101, 0, 1024, 16384 };
+	for (int argument_index = 3; argument_index + 1 < argc; argument_index += 2)
+	{
+		const char* option = argv[argument_index];
+		const char* value = argv[argument_index + 1];
+		if (std::strcmp(option, "--output") == 0) output_file_name = value;
+		else if (std::strcmp(option, "--threads") == 0) settings.number_of_threads = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "--simulations") == 0) settings.number_of_simulations = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "--seed") == 0) settings.seed = std::strtoull(value, nullptr, 10);
+		else if (std::strcmp(option, "--group-size") == 0) settings.maximum_group_size = std::strtoul(value, nullptr, 10);
+		else {
+			std::cerr << "Unknown option " << option << "\n";
+			print_usage();
+			return 1;
+		}
+	}
+	if (settings.number_of_simulations == 0 || settings.maximum_group_size == 0) {
+		std::cerr << "The number of simulations and the group size must be positive\n";
+		return 1;
+	}
+
+	TradeReader reader(trade_file_name);
+	if (!reader.isOpen()) {
+		std::cerr << "Cannot read " << trade_file_name << "\n";
+		return 1;
+	}
+	std::ofstream output_file;
+	if (!output_file_name.empty()) {
+		output_file.open(output_file_name);
+		if (!output_file.is_open()) {
+			std::cerr << "Cannot write " << output_file_name << "\n";
+			return 1;
+		}
+	}
+
+	BatchPricer batch_pricer(settings);
+	size_t number_of_trades = batch_pricer.run(reader, output_file_name.empty() ? std::cout : output_file);
+	std::cerr << number_of_trades << " trades priced\n";
+	return 0;
 }
 
+int run_convert(const char* trade_file_name, const char* binary_file_name)
+{
+	TradeReader reader(trade_file_name);
+	TradeWriter writer(binary_file_name);
+	if (!reader.isOpen() || !writer.isOpen()) {
+		std::cerr << "Cannot convert " << trade_file_name << " to " << binary_file_name << "\n";
+		return 1;
+	}
+	Trade trade;
+	size_t number_of_trades = 0;
+	while (reader.next(trade)) {
+		writer.write(trade);
+		++number_of_trades;
+	}
+	std::cerr << number_of_trades << " trades converted\n";
+	return 0;
+}
+
+#ifndef _WIN32
+// Pricing server on a Unix socket, until a shutdown request
+int run_server(int argc, char** argv)
+{
+	std::string socket_path = argv[2];
+	PricingServerSettings settings = { 10000, 20240101, 0, 1024, 0.002, 256 };
+	for (int argument_index = 3; argument_index + 1 < argc; argument_index += 2)
+	{
+		const char* option = argv[argument_index];
+		const char* value = argv[argument_index + 1];
+		if (std::strcmp(option, "--threads") == 0) settings.number_of_threads = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "--simulations") == 0) settings.number_of_simulations = std::strtoul(value, nullptr, 10);
+		else if (std::strcmp(option, "--seed") == 0) settings.seed = std::strtoull(value, nullptr, 10);
+		else if (std::strcmp(option, "--window") == 0) settings.batching_window = std::strtod(value, nullptr) / 1000.;
+		else {
+			std::cerr << "Unknown option " << option << "\n";
+			print_usage();
+			return 1;
+		}
+	}
+	if (settings.number_of_simulations == 0) {
+		std::cerr << "The number of simulations must be positive\n";
+		return 1;
+	}
 
+	PricingServer server(settings);
+	if (!server.run(socket_path))
+		return 1;
+	LatencyStatistics statistics = server.getLatencyStatistics();
+	std::cerr << statistics.number_of_requests << " requests answered, latency median " << 1000. * statistics.median
+		<< " ms, 99% " << 1000. * statistics.percentile_99 << " ms\n";
+	return 0;
+}
+#endif
+
+int main(int argc, char** argv) {
+	if (argc >= 3 && std::strcmp(argv[1], "--batch") == 0)
+		return run_batch(argc, argv);
+#ifndef _WIN32
+	if (argc >= 3 && std::strcmp(argv[1], "--serve") == 0)
+		return run_server(argc, argv);
+#endif
+	if (argc == 4 && std::strcmp(argv[1], "--convert") == 0)
+		return run_convert(argv[2], argv[3]);
+	if (argc > 1) {
+		print_usage();
+		return 1;
+	}
 
-int main() {
-	srand(time(NULL));
+	// Explicit seed, so that every run can be reproduced
+	unsigned long long seed = 20240101;
+	RandomNormalGenerator::seed(seed, 0);
 	testing_pricer_2D();
 
 	return 0;
@@ -0,0 +1,306 @@
+#include "RandomEngine.h"
+#include <cmath>
+
+// Philox4x32 round constants
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+// Maps a 32 bits integer to ]0, 1[
+static double toUniform(uint32_t x)
+{
+	return ((double)x + 0.5) / 4294967296.;
+}
+
+// Rational approximation of P. J. Acklam (relative error below 1.2e-9), refined by one step of Halley's method
+double inverseNormalCDF(double u)
+{
+	static const double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+		1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+	static const double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+		6.680131188771972e+01, -1.328068155288572e+01 };
+	static const double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+		-2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+	static const double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+		3.754408661907416e+00 };
+	const double u_low = 0.02425;
+
+	double x;
+	if (u < u_low) {
+		double q = sqrt(-2. * log(u));
+		x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.);
+	}
+	else if (u <= 1. - u_low) {
+		double q = u - 0.5;
+		double r = q * q;
+		x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+			/ (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.);
+	}
+	else {
+		double q = sqrt(-2. * log(1. - u));
+		x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.);
+	}
+
+	double error = 0.5 * erfc(-x / sqrt(2.)) - u;
+	double step = error * sqrt(8. * atan(1.)) * exp(0.5 * x * x);
+	return x - step / (1. + 0.5 * x * step);
+}
+
+double RandomEngine::normalRandom()
+{
+	double u1 = uniformRandom();
+	double u2 = uniformRandom();
+	return cos(8. * atan(1.) * u2) * sqrt(-2. * log(u1));
+}
+
+void RandomEngine::fillUniforms(double* uniforms, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		uniforms[i] = uniformRandom();
+}
+
+void RandomEngine::fillNormals(double* normals, size_t n)
+{
+	// Box-Muller by pairs: both the cosine and the sine are used, so we need one uniform per normal
+	fillUniforms(normals, n);
+	double two_pi = 8. * atan(1.);
+	for (size_t i = 0; i + 1 < n; i += 2)
+	{
+		double radius = sqrt(-2. * log(normals[i]));
+		double angle = two_pi * normals[i + 1];
+		normals[i] = radius * cos(angle);
+		normals[i + 1] = radius * sin(angle);
+	}
+	if (n % 2 == 1)
+		normals[n - 1] = normalRandom();
+}
+
+PhiloxEngine::PhiloxEngine(uint64_t seed) :
+	_seed(seed), _path_index(0), _block_index(0), _position(UNIFORMS_PER_STEP)
+{
+}
+
+PhiloxEngine* PhiloxEngine::clone() const
+{
+	return new PhiloxEngine(*this);
+}
+
+uint64_t PhiloxEngine::getSeed() const
+{
+	return _seed;
+}
+
+void PhiloxEngine::block(uint64_t block_index, uint32_t output[4]) const
+{
+	uint32_t counter[4] = { (uint32_t)block_index, (uint32_t)(block_index >> 32),
+		(uint32_t)_path_index, (uint32_t)(_path_index >> 32) };
+	uint32_t key[2] = { (uint32_t)_seed, (uint32_t)(_seed >> 32) };
+
+	for (int round = 0; round < 10; ++round)
+	{
+		uint64_t product0 = (uint64_t)PHILOX_M0 * counter[0];
+		uint64_t product1 = (uint64_t)PHILOX_M1 * counter[2];
+		uint32_t next[4] = {
+			(uint32_t)(product1 >> 32) ^ counter[1] ^ key[0],
+			(uint32_t)product1,
+			(uint32_t)(product0 >> 32) ^ counter[3] ^ key[1],
+			(uint32_t)product0 };
+		for (int i = 0; i < 4; ++i)
+			counter[i] = next[i];
+		key[0] += PHILOX_W0;
+		key[1] += PHILOX_W1;
+	}
+
+	for (int i = 0; i < 4; ++i)
+		output[i] = counter[i];
+}
+
+// The draws of a step are generated at once, so the schemas only read a buffer
+void PhiloxEngine::refill()
+{
+	uint32_t output[UNIFORMS_PER_BLOCK];
+	for (size_t i = 0; i < UNIFORMS_PER_STEP; i += UNIFORMS_PER_BLOCK)
+	{
+		block(_block_index++, output);
+		for (size_t j = 0; j < UNIFORMS_PER_BLOCK; ++j)
+			_buffer[i + j] = toUniform(output[j]);
+	}
+	_position = 0;
+}
+
+void PhiloxEngine::fillUniforms(double* uniforms, size_t n)
+{
+	size_t i = 0;
+	// First the draws already generated
+	while (i < n && _position < UNIFORMS_PER_STEP)
+		uniforms[i++] = _buffer[_position++];
+
+	// Then whole blocks written directly in the caller buffer
+	uint32_t output[UNIFORMS_PER_BLOCK];
+	for (; i + UNIFORMS_PER_BLOCK <= n; i += UNIFORMS_PER_BLOCK)
+	{
+		block(_block_index++, output);
+		for (size_t j = 0; j < UNIFORMS_PER_BLOCK; ++j)
+			uniforms[i + j] = toUniform(output[j]);
+	}
+
+	while (i < n)
+		uniforms[i++] = uniformRandom();
+}
+
+AntitheticEngine::AntitheticEngine(const RandomEngine& engine) :
+	_engine(engine.clone()), _is_mirror(false)
+{
+}
+
+AntitheticEngine::AntitheticEngine(const AntitheticEngine& engine) :
+	_engine(engine._engine->clone()), _is_mirror(engine._is_mirror)
+{
+}
+
+AntitheticEngine& AntitheticEngine::operator=(const AntitheticEngine& engine)
+{
+	if (!(this == &engine)) {
+		delete _engine;
+		_engine = engine._engine->clone();
+		_is_mirror = engine._is_mirror;
+	}
+	return *this;
+}
+
+AntitheticEngine::~AntitheticEngine()
+{
+	delete _engine;
+}
+
+AntitheticEngine* AntitheticEngine::clone() const
+{
+	return new AntitheticEngine(*this);
+}
+
+void AntitheticEngine::skipTo(uint64_t path_index, uint64_t step_index)
+{
+	_engine->skipTo(path_index / 2, step_index);
+	_is_mirror = (path_index % 2 == 1);
+}
+
+double AntitheticEngine::uniformRandom()
+{
+	double uniform = _engine->uniformRandom();
+	return _is_mirror ? 1. - uniform : uniform;
+}
+
+double AntitheticEngine::normalRandom()
+{
+	double normal = _engine->normalRandom();
+	return _is_mirror ? -normal : normal;
+}
+
+void AntitheticEngine::fillUniforms(double* uniforms, size_t n)
+{
+	_engine->fillUniforms(uniforms, n);
+	if (_is_mirror) {
+		for (size_t i = 0; i < n; ++i)
+			uniforms[i] = 1. - uniforms[i];
+	}
+}
+
+void AntitheticEngine::fillNormals(double* normals, size_t n)
+{
+	_engine->fillNormals(normals, n);
+	if (_is_mirror) {
+		for (size_t i = 0; i < n; ++i)
+			normals[i] = -normals[i];
+	}
+}
+
+CoarsenedEngine::CoarsenedEngine(const RandomEngine& engine, size_t number_of_fine_steps, size_t coarsening) :
+	_engine(engine.clone()), _coarsening(coarsening), _has_path(false), _path_index(0), _step_index(0), _draws_in_step(0),
+	_uniforms_in_step(0), _variance_normals(number_of_fine_steps / coarsening), _spot_normals(number_of_fine_steps / coarsening)
+{
+}
+
+CoarsenedEngine::CoarsenedEngine(const CoarsenedEngine& engine) :
+	_engine(engine._engine->clone()), _coarsening(engine._coarsening), _has_path(engine._has_path), _path_index(engine._path_index),
+	_step_index(engine._step_index), _draws_in_step(engine._draws_in_step), _uniforms_in_step(engine._uniforms_in_step),
+	_variance_normals(engine._variance_normals), _spot_normals(engine._spot_normals)
+{
+}
+
+CoarsenedEngine& CoarsenedEngine::operator=(const CoarsenedEngine& engine)
+{
+	if (!(this == &engine)) {
+		delete _engine;
+		_engine = engine._engine->clone();
+		_coarsening = engine._coarsening;
+		_has_path = engine._has_path;
+		_path_index = engine._path_index;
+		_step_index = engine._step_index;
+		_draws_in_step = engine._draws_in_step;
+		_uniforms_in_step = engine._uniforms_in_step;
+		_variance_normals = engine._variance_normals;
+		_spot_normals = engine._spot_normals;
+	}
+	return *this;
+}
+
+CoarsenedEngine::~CoarsenedEngine()
+{
+	delete _engine;
+}
+
+CoarsenedEngine* CoarsenedEngine::clone() const
+{
+	return new CoarsenedEngine(*this);
+}
+
+void CoarsenedEngine::generatePath(uint64_t path_index)
+{
+	double scale = 1. / sqrt((double)_coarsening);
+	for (size_t step = 0; step < _variance_normals.size(); ++step) {
+		double variance_normal = 0., spot_normal = 0.;
+		for (size_t fine_step = step * _coarsening; fine_step < (step + 1) * _coarsening; ++fine_step) {
+			_engine->skipTo(path_index, fine_step);
+			variance_normal += _engine->normalRandom();
+			spot_normal += _engine->normalRandom();
+		}
+		_variance_normals[step] = variance_normal * scale;
+		_spot_normals[step] = spot_normal * scale;
+	}
+	_has_path = true;
+	_path_index = path_index;
+}
+
+void CoarsenedEngine::skipTo(uint64_t path_index, uint64_t step_index)
+{
+	if (!_has_path || path_index != _path_index)
+		generatePath(path_index);
+	_step_index = step_index;
+	_draws_in_step = 0;
+	_uniforms_in_step = 0;
+	// The further draws of the step: a step of the engine after the fine steps, never read by generatePath
+	_engine->skipTo(path_index, _variance_normals.size() * _coarsening + step_index);
+}
+
+double CoarsenedEngine::normalRandom()
+{
+	size_t draw = _draws_in_step++;
+	if (draw == 0)
+		return _variance_normals[_step_index];
+	if (draw == 1)
+		return _spot_normals[_step_index];
+	return _engine->normalRandom();
+}
+
+double CoarsenedEngine::uniformRandom()
+{
+	if (_uniforms_in_step++ == 0)
+		return 0.5 * erfc(-_variance_normals[_step_index] / sqrt(2.));
+	return _engine->uniformRandom();
+}
+
+void CoarsenedEngine::fillUniforms(double* uniforms, size_t n)
+{
+	_engine->fillUniforms(uniforms, n);
+}
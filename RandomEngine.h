@@ -0,0 +1,148 @@
+#ifndef RANDOMENGINE_H
+#define RANDOMENGINE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Inverse of the standard normal cumulative distribution function, for u in ]0, 1[
+double inverseNormalCDF(double u);
+
+// Interface of the random number engines used by the schemas and the path simulators.
+// A stream of draws is addressed by a (path, step) coordinate, so any path can be regenerated independently of the others.
+class RandomEngine
+{
+public:
+	virtual ~RandomEngine() = default;
+	virtual RandomEngine* clone() const = 0;
+
+	// Moves the engine to the first draw of the given step of the given path, in O(1)
+	virtual void skipTo(uint64_t path_index, uint64_t step_index) = 0;
+
+	virtual double uniformRandom() = 0;
+	virtual double normalRandom();
+
+	// Block API: fills the caller buffer with the next n draws of the stream
+	virtual void fillUniforms(double* uniforms, size_t n);
+	virtual void fillNormals(double* normals, size_t n);
+};
+
+// Counter-based engine Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The seed is the key, and the counter is made of the path index and of the block index inside the path:
+// there is no hidden state, and skipping to any (path, step) only means setting the counter.
+class PhiloxEngine final : public RandomEngine
+{
+public:
+	// Number of uniforms reserved for each step: a step using at most this number of draws never overlaps the next one
+	static const size_t UNIFORMS_PER_STEP = 8;
+	// Number of uniforms given by one evaluation of the Philox function
+	static const size_t UNIFORMS_PER_BLOCK = 4;
+
+	PhiloxEngine(uint64_t seed);
+	PhiloxEngine* clone() const override;
+
+	// Defined in the header: the class being final, they are inlined when called on a PhiloxEngine (see PathKernel.h)
+	void skipTo(uint64_t path_index, uint64_t step_index) override;
+	double uniformRandom() override;
+	double normalRandom() override;
+	void fillUniforms(double* uniforms, size_t n) override;
+
+	uint64_t getSeed() const;
+
+private:
+	// 4 random 32 bits integers for the given counter
+	void block(uint64_t block_index, uint32_t output[4]) const;
+	void refill();
+
+	uint64_t _seed;
+	uint64_t _path_index;
+	uint64_t _block_index;
+	double _buffer[UNIFORMS_PER_STEP];
+	size_t _position;
+};
+
+inline void PhiloxEngine::skipTo(uint64_t path_index, uint64_t step_index)
+{
+	_path_index = path_index;
+	_block_index = step_index * (UNIFORMS_PER_STEP / UNIFORMS_PER_BLOCK);
+	_position = UNIFORMS_PER_STEP;
+}
+
+inline double PhiloxEngine::uniformRandom()
+{
+	if (_position == UNIFORMS_PER_STEP)
+		refill();
+	return _buffer[_position++];
+}
+
+// Same draw as RandomEngine::normalRandom
+inline double PhiloxEngine::normalRandom()
+{
+	double u1 = uniformRandom();
+	double u2 = uniformRandom();
+	return std::cos(8. * std::atan(1.) * u2) * std::sqrt(-2. * std::log(u1));
+}
+
+// Antithetic pairs on top of another engine: paths 2k and 2k + 1 both read the path k of the engine,
+// the second one with the normals negated and the uniforms replaced by 1 - u.
+// Both draws go through the same inverse distributions in the schemas (the exponential branch of QE, the clamp of TG),
+// so the two paths of a pair are exact mirrors of each other.
+class AntitheticEngine final : public RandomEngine
+{
+public:
+	AntitheticEngine(const RandomEngine& engine);
+	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
+	AntitheticEngine(const AntitheticEngine& engine);
+	AntitheticEngine& operator=(const AntitheticEngine& engine);
+	~AntitheticEngine();
+	AntitheticEngine* clone() const override;
+
+	void skipTo(uint64_t path_index, uint64_t step_index) override;
+	double uniformRandom() override;
+	double normalRandom() override;
+	void fillUniforms(double* uniforms, size_t n) override;
+	void fillNormals(double* normals, size_t n) override;
+
+private:
+	RandomEngine* _engine;
+	bool _is_mirror;
+};
+
+// Coupled draws of the multilevel estimators: step j of a path is driven by the fine steps j * coarsening to
+// (j + 1) * coarsening - 1 of the engine, whose normals (one for the variance, one for the spot) are summed and divided
+// by sqrt(coarsening). With the time gaps of the fine grid split evenly, the coarse path then sees the same Brownian
+// increments as the fine one. As in SobolEngine, the first normal of a step is the variance one, the second the spot one,
+// and the first uniform is Phi(variance normal), so the QE schema is coupled in both of its branches. The further draws of
+// a step (the integrated variance of schemaIG) are independent: they come from the step number_of_fine_steps + step of the engine.
+class CoarsenedEngine final : public RandomEngine
+{
+public:
+	CoarsenedEngine(const RandomEngine& engine, size_t number_of_fine_steps, size_t coarsening);
+	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
+	CoarsenedEngine(const CoarsenedEngine& engine);
+	CoarsenedEngine& operator=(const CoarsenedEngine& engine);
+	~CoarsenedEngine();
+	CoarsenedEngine* clone() const override;
+
+	void skipTo(uint64_t path_index, uint64_t step_index) override;
+	double uniformRandom() override;
+	double normalRandom() override;
+	// Further draws (after the two normals and the first uniform of a step) come from the engine, after the fine steps of the path
+	void fillUniforms(double* uniforms, size_t n) override;
+
+private:
+	void generatePath(uint64_t path_index);
+
+	RandomEngine* _engine;
+	size_t _coarsening;
+	bool _has_path;
+	uint64_t _path_index;
+	uint64_t _step_index;
+	size_t _draws_in_step;
+	size_t _uniforms_in_step;
+	std::vector<double> _variance_normals;
+	std::vector<double> _spot_normals;
+};
+
+#endif // !RANDOMENGINE_H
@@ -1,16 +1,31 @@
 #include "RandomNormalGenerator.h"
-#include <cmath>
+#include <memory>
 
+// One engine per thread, so no state is shared between the workers
+static thread_local std::unique_ptr<RandomEngine> thread_engine(new PhiloxEngine(0));
 
 double RandomNormalGenerator::normalRandom()
 {
-	double u1 = uniformRandom();
-	double u2 = uniformRandom();
-	return cos(8.*atan(1.)*u2)*sqrt(-2.*log(u1));
+	return thread_engine->normalRandom();
 }
 
 double RandomNormalGenerator::uniformRandom()
 {
-	return ((double)(rand()) + 1.) / ((double)(RAND_MAX) + 2.);
+	return thread_engine->uniformRandom();
 }
 
+RandomEngine& RandomNormalGenerator::engine()
+{
+	return *thread_engine;
+}
+
+void RandomNormalGenerator::setEngine(const RandomEngine& engine)
+{
+	thread_engine.reset(engine.clone());
+}
+
+void RandomNormalGenerator::seed(unsigned long long seed, unsigned long long stream_index)
+{
+	thread_engine.reset(new PhiloxEngine(seed));
+	thread_engine->skipTo(stream_index, 0);
+}
@@ -1,6 +1,7 @@
 #ifndef RANDOMNORMALGENERATOR_H
 #define RANDOMNORMALGENERATOR_H
 
+#include "RandomEngine.h"
 
 class RandomNormalGenerator
 {
@@ -8,6 +9,12 @@ public:
 	// What is a static method?
 	static double normalRandom();
 	static double uniformRandom();
+
+	// The engine is owned by the calling thread, so each worker of a parallel pricing has its own stream.
+	// By default it is a PhiloxEngine, seed() sets its key and puts it at the beginning of the given stream.
+	static RandomEngine& engine();
+	static void setEngine(const RandomEngine& engine);
+	static void seed(unsigned long long seed, unsigned long long stream_index);
 };
 
 
@@ -0,0 +1,118 @@
+#include "RunningStatistics.h"
+
+#include <cmath>
+
+RunningStatistics::RunningStatistics() :
+	_count(0), _mean(0.), _m2(0.)
+{
+}
+
+void RunningStatistics::add(double x)
+{
+	++_count;
+	double delta = x - _mean;
+	_mean += delta / (double)_count;
+	_m2 += delta * (x - _mean);
+}
+
+void RunningStatistics::merge(const RunningStatistics& other)
+{
+	if (other._count == 0)
+		return;
+	if (_count == 0) {
+		*this = other;
+		return;
+	}
+	double count = (double)(_count + other._count);
+	double delta = other._mean - _mean;
+	_mean += delta * (double)other._count / count;
+	_m2 += other._m2 + delta * delta * (double)_count * (double)other._count / count;
+	_count += other._count;
+}
+
+size_t RunningStatistics::getCount() const
+{
+	return _count;
+}
+
+double RunningStatistics::getMean() const
+{
+	return _mean;
+}
+
+double RunningStatistics::getVariance() const
+{
+	return (_count > 1) ? _m2 / (double)(_count - 1) : 0.;
+}
+
+double RunningStatistics::getStandardError() const
+{
+	return (_count > 0) ? sqrt(getVariance() / (double)_count) : 0.;
+}
+
+RunningCovariance::RunningCovariance() :
+	_count(0), _mean_x(0.), _mean_y(0.), _m2_x(0.), _m2_y(0.), _c_xy(0.)
+{
+}
+
+void RunningCovariance::add(double x, double y)
+{
+	++_count;
+	double delta_x = x - _mean_x;
+	double delta_y = y - _mean_y;
+	_mean_x += delta_x / (double)_count;
+	_mean_y += delta_y / (double)_count;
+	_m2_x += delta_x * (x - _mean_x);
+	_m2_y += delta_y * (y - _mean_y);
+	_c_xy += delta_x * (y - _mean_y);
+}
+
+void RunningCovariance::merge(const RunningCovariance& other)
+{
+	if (other._count == 0)
+		return;
+	if (_count == 0) {
+		*this = other;
+		return;
+	}
+	double count = (double)(_count + other._count);
+	double weight = (double)_count * (double)other._count / count;
+	double delta_x = other._mean_x - _mean_x;
+	double delta_y = other._mean_y - _mean_y;
+	_mean_x += delta_x * (double)other._count / count;
+	_mean_y += delta_y * (double)other._count / count;
+	_m2_x += other._m2_x + delta_x * delta_x * weight;
+	_m2_y += other._m2_y + delta_y * delta_y * weight;
+	_c_xy += other._c_xy + delta_x * delta_y * weight;
+	_count += other._count;
+}
+
+size_t RunningCovariance::getCount() const
+{
+	return _count;
+}
+
+double RunningCovariance::getMeanX() const
+{
+	return _mean_x;
+}
+
+double RunningCovariance::getMeanY() const
+{
+	return _mean_y;
+}
+
+double RunningCovariance::getVarianceX() const
+{
+	return (_count > 1) ? _m2_x / (double)(_count - 1) : 0.;
+}
+
+double RunningCovariance::getVarianceY() const
+{
+	return (_count > 1) ? _m2_y / (double)(_count - 1) : 0.;
+}
+
+double RunningCovariance::getCovariance() const
+{
+	return (_count > 1) ? _c_xy / (double)(_count - 1) : 0.;
+}
@@ -0,0 +1,54 @@
+#ifndef RUNNINGSTATISTICS_H
+#define RUNNINGSTATISTICS_H
+
+#include <cstddef>
+
+// Mean and variance of a sample, updated one value at a time (Welford's algorithm).
+// Two statistics can be merged (Chan et al.), so each worker can keep its own and they are reduced at the end.
+class RunningStatistics
+{
+public:
+	RunningStatistics();
+
+	void add(double x);
+	void merge(const RunningStatistics& other);
+
+	size_t getCount() const;
+	double getMean() const;
+	// Unbiased variance of the sample
+	double getVariance() const;
+	// Standard error of the mean
+	double getStandardError() const;
+
+private:
+	size_t _count;
+	double _mean;
+	double _m2;
+};
+
+// Same for a sample of pairs (x, y), with the covariance of x and y
+class RunningCovariance
+{
+public:
+	RunningCovariance();
+
+	void add(double x, double y);
+	void merge(const RunningCovariance& other);
+
+	size_t getCount() const;
+	double getMeanX() const;
+	double getMeanY() const;
+	double getVarianceX() const;
+	double getVarianceY() const;
+	double getCovariance() const;
+
+private:
+	size_t _count;
+	double _mean_x;
+	double _mean_y;
+	double _m2_x;
+	double _m2_y;
+	double _c_xy;
+};
+
+#endif
@@ -1,36 +1,28 @@
 #include "Schema.h"
 #include "RandomNormalGenerator.h"
 #include "GridFunction.h"
+#include "StepKernels.h"
+
+#include <algorithm>
+#include <limits>
 
 schema::schema(Pair initial_factors,
     const Vector& time_points,
     const Model2D& model) :
-    _initial_factors(initial_factors), _time_points(time_points), _model(model.clone())
+    _initial_factors(initial_factors), _context(PricingContext::create(model, time_points))
 {
 }
 
-schema::schema(const schema& schema_ex) :
-    _initial_factors(schema_ex._initial_factors), _time_points(schema_ex._time_points),
-    _model(schema_ex._model->clone())
+schema* schema::cloneWithTimePoints(const Vector& time_points) const
 {
+    schema* refined_schema = clone();
+    refined_schema->setTimePoints(time_points);
+    return refined_schema;
 }
 
-// P2 = P1 equivalent to P2.operator=(P1)
-schema& schema::operator=(const schema& schema_ex) {
-    // check for "self assignment" and do nothing in that case
-    if (!(this == &schema_ex)) {
-        delete _model;
-        _model = schema_ex._model->clone();	// allocate new memory for the pointer
-
-        // assignment for other fields
-        _initial_factors = schema_ex._initial_factors;
-        _time_points = schema_ex._time_points;
-    }
-    return *this;
-}
-
-schema::~schema() {
-    delete _model;
+void schema::setTimePoints(const Vector& time_points)
+{
+    _context = PricingContext::create(*_context->getModel(), time_points);
 }
 
 Pair schema::getInitialFactors() const
@@ -38,33 +30,63 @@ Pair schema::getInitialFactors() const
     return _initial_factors;
 }
 
-Vector schema::getTimePoints() const
+const Vector& schema::getTimePoints() const
 {
-    return _time_points;
+    return _context->getTimePoints();
 }
 
 const Model2D* schema::getModel() const
 {
-    return _model;
+    return _context->getModel();
+}
+
+const StepPlan& schema::getStepPlan() const
+{
+    return _context->getStepPlan();
+}
+
+const std::shared_ptr<const PricingContext>& schema::getContext() const
+{
+    return _context;
+}
+
+double schema::nextStepVolatility(int current_index, Pair current_factors) const
+{
+    return nextStepVolatility(current_index, current_factors, RandomNormalGenerator::engine());
+}
+
+double schema::nextStepSpot(double v_delta, int current_index, Pair current_factors) const
+{
+    return nextStepSpot(v_delta, current_index, current_factors, RandomNormalGenerator::engine());
 }
 
 // TODO: Enhance the method (trapeze method ?)
 double schema::nextStepSpot(double v_delta, int current_index,
-    Pair current_factors) const {
-    double randomNormal = RandomNormalGenerator::normalRandom();
-    double cur_time = _time_points[current_index];
-    double time_gap = _time_points[current_index + 1] - cur_time;
-    double v = current_factors.second;
+    Pair current_factors, RandomEngine& engine) const {
     double log_spot = log(current_factors.first);
+    return exp(stepLogSpot(getStepPlan().getStep(current_index), log_spot, current_factors.second, v_delta, engine));
+}
 
+void schema::nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+    const double* normals, double* log_spots, size_t n) const {
+    const StepCoefficients& step = getStepPlan().getStep(current_index);
+    double K0 = step.K0, K1 = step.K1, K2 = step.K2, K3 = step.K3, K4 = step.K4;
 
-    double intApproximationTime = time_gap * (v + v_delta) * 0.5;
-    double intApproximationBrown = sqrt(time_gap * (v + v_delta) * 0.5) * randomNormal;
-    double log_spot_delta = log_spot + _model->get_correlation() / _model->get_vol_of_vol()
-        * (v_delta - v - _model->get_mean_reversion_speed() * _model->get_mean_reversion_level() * time_gap) +
-        (_model->get_mean_reversion_speed() * _model->get_correlation() / _model->get_vol_of_vol() - 0.5) * intApproximationTime
-        + sqrt(1. - _model->get_correlation() * _model->get_correlation()) * intApproximationBrown;
-    return exp(log_spot_delta);
+    for (size_t i = 0; i < n; ++i) {
+        double v = variances[i];
+        double v_delta = next_variances[i];
+        log_spots[i] += K0 + K1 * v + K2 * v_delta + sqrt(K3 * v + K4 * v_delta) * normals[i];
+    }
+}
+
+bool schema::samplesIntegratedVariance() const
+{
+    return false;
+}
+
+void schema::nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+    const double* /*integrated_normals*/, const double* /*integrated_uniforms*/, const double* normals, double* log_spots, size_t n) const {
+    nextStepLogSpotBatch(current_index, variances, next_variances, normals, log_spots, n);
 }
 
 schemaQE::schemaQE(Pair initial_factors,
@@ -85,53 +107,46 @@ double schemaQE::getPsiC() const
 	return _psiC;
 }
 
-double schemaQE::nextStepVolatility(int current_index, Pair current_factors) const {
-    double cur_time = _time_points[current_index];
-    double time_gap = _time_points[current_index + 1] - cur_time;
-    double v_hat = current_factors.second;
-
-    //We have two independent normal random variables N(0,1)
-    double randomNormal = RandomNormalGenerator::normalRandom();
-   
-    double m = _model->get_mean_reversion_level() + (v_hat - _model->get_mean_reversion_level()) * exp(-_model->get_mean_reversion_speed() * time_gap);
-    double s_square = ((v_hat * _model->get_vol_of_vol() * _model->get_vol_of_vol() * exp(-_model->get_mean_reversion_speed() * time_gap)) / _model->get_mean_reversion_speed())
-        * (1. - exp(-_model->get_mean_reversion_speed() * time_gap)) +
-        (_model->get_mean_reversion_level() * _model->get_vol_of_vol() * _model->get_vol_of_vol() *
-            (1. - exp(-_model->get_mean_reversion_speed() * time_gap)) * (1 - exp(-_model->get_mean_reversion_speed() * time_gap)))
-        / (2. * _model->get_mean_reversion_speed());
-
-    double psi = s_square / (m * m);
-    double psiInv = 1. / psi;
-    double uV = RandomNormalGenerator::uniformRandom();
-    double nextStep;
-
-    if (psi <= _psiC) {
-        double b_square = 2. * psiInv - 1. + sqrt(2. * psiInv) * sqrt(2. * psiInv - 1.);
+double schemaQE::nextStepVolatility(int current_index, Pair current_factors, RandomEngine& engine) const {
+    return stepVarianceQE(getStepPlan().getStep(current_index), _psiC, current_factors.second, engine);
+}
+
+// Both branches are computed for every path and then blended on psi <= psiC, so that the vector lanes never diverge
+void schemaQE::nextStepVolatilityBatch(int current_index, const double* variances, const double* normals,
+    const double* uniforms, double* next_variances, size_t n) const {
+    const StepCoefficients& step = getStepPlan().getStep(current_index);
+    double m_constant = step.m_constant, m_slope = step.m_slope;
+    double s_square_constant = step.s_square_constant, s_square_slope = step.s_square_slope;
+    double psiC = _psiC;
+
+    for (size_t i = 0; i < n; ++i) {
+        double v_hat = variances[i];
+        double m = m_constant + m_slope * v_hat;
+        double s_square = s_square_constant + s_square_slope * v_hat;
+        double psi = s_square / (m * m);
+        double psiInv = 1. / psi;
+
+        // Quadratic branch, the max only avoids a NaN in the lanes where psi > 2 (they take the other branch)
+        double two_psiInv_minus_one = std::max(2. * psiInv - 1., 0.);
+        double b_square = two_psiInv_minus_one + sqrt(2. * psiInv) * sqrt(two_psiInv_minus_one);
         double b = sqrt(b_square);
         double a = m / (1. + b_square);
-        nextStep = a * (b + randomNormal) * (b + randomNormal);
-        return nextStep;
-    }
-    else {
+        double quadratic = a * (b + normals[i]) * (b + normals[i]);
+
+        // Exponential branch
         double p = (psi - 1.) / (psi + 1.);
         double beta = (1. - p) / m;
+        double uV = uniforms[i];
+        double exponential_branch = (p >= uV) ? 0. : (1. / beta) * log((1. - p) / (1. - uV));
 
-        if (p >= uV && uV >= 0.) {
-            nextStep = 0.;
-            return nextStep;
-        }
-        nextStep = (1. / beta) * log((1. - p) / (1. - uV));
-        return nextStep;
+        next_variances[i] = (psi <= psiC) ? quadratic : exponential_branch;
     }
 }
 
 schemaTG::schemaTG(Pair initial_factors, const Vector& time_points, const Model2D& model, Pair interval, int number_points) :
-    schema(initial_factors, time_points, model), _interval(interval), _number_points(number_points)
+    schema(initial_factors, time_points, model), _interval(interval), _number_points(number_points),
+    _grids(TGGridCache::get(interval, number_points))
 {
-    gridFunction gridObj(interval, number_points);
-    _gridR = gridObj.getGridFunctionR();
-    _gridMu = gridObj.getGridFunctionMu();
-    _gridSigma = gridObj.getGridFunctionSigma();
 }
 
 schemaTG* schemaTG::clone() const
@@ -139,31 +154,236 @@ schemaTG* schemaTG::clone() const
     return new schemaTG(*this);
 }
 
-double schemaTG::nextStepVolatility(int current_index, Pair current_factors) const
+const TGGrids& schemaTG::getGrids() const
+{
+    return *_grids;
+}
+
+double schemaTG::nextStepVolatility(int current_index, Pair current_factors, RandomEngine& engine) const
+{
+    return stepVarianceTG(getStepPlan().getStep(current_index), *_grids, current_factors.second, engine);
+}
+
+// The paths are processed by chunks: psi for the whole chunk, then the lookups, then the new variances
+void schemaTG::nextStepVolatilityBatch(int current_index, const double* variances, const double* normals,
+    const double* /*uniforms*/, double* next_variances, size_t n) const
+{
+    const size_t CHUNK_SIZE = 256;
+    const StepCoefficients& step = getStepPlan().getStep(current_index);
+    double m_constant = step.m_constant, m_slope = step.m_slope;
+    double s_square_constant = step.s_square_constant, s_square_slope = step.s_square_slope;
+    double psi[CHUNK_SIZE];
+    double fMu[CHUNK_SIZE];
+    double fSigma[CHUNK_SIZE];
+
+    for (size_t first = 0; first < n; first += CHUNK_SIZE) {
+        size_t size = std::min(CHUNK_SIZE, n - first);
+        const double* v_hat = variances + first;
+
+        for (size_t i = 0; i < size; ++i) {
+            double m = m_constant + m_slope * v_hat[i];
+            psi[i] = (s_square_constant + s_square_slope * v_hat[i]) / (m * m);
+        }
+
+        _grids->tableMu.evaluate(psi, fMu, size);
+        _grids->tableSigma.evaluate(psi, fSigma, size);
+
+        for (size_t i = 0; i < size; ++i) {
+            double m = m_constant + m_slope * v_hat[i];
+            double s_square = s_square_constant + s_square_slope * v_hat[i];
+            double mu = fMu[i] * m;
+            double sigma_hat = fSigma[i] * sqrt(s_square);
+            next_variances[first + i] = std::max(mu + sigma_hat * normals[first + i], 0.);
+        }
+    }
+}
+
+static const double PI = 3.14159265358979323846;
+
+// Ratio I_{nu+1}(z) / I_nu(z) of modified Bessel functions, for nu > -1 and z > 0
+static double besselRatio(double nu, double z)
 {
-    double cur_time = _time_points[current_index];
-    double time_gap = _time_points[current_index + 1] - cur_time;
-    double randomNormal = RandomNormalGenerator::normalRandom();
-    double v_hat = current_factors.second;
-    gridFunction gridFunc(_interval, _number_points);
+    if (z > 100. + nu * nu) {
+        // Hankel expansion of both functions, the exponential factors cancel
+        double numerator = 1., denominator = 1., term_numerator = 1., term_denominator = 1.;
+        double mu_numerator = 4. * (nu + 1.) * (nu + 1.), mu_denominator = 4. * nu * nu;
+        for (int k = 1; k <= 12; ++k) {
+            double odd = (2. * k - 1.) * (2. * k - 1.);
+            term_numerator *= -(mu_numerator - odd) / (8. * k * z);
+            term_denominator *= -(mu_denominator - odd) / (8. * k * z);
+            numerator += term_numerator;
+            denominator += term_denominator;
+        }
+        return numerator / denominator;
+    }
 
-    double m = _model->get_mean_reversion_level() + (v_hat - _model->get_mean_reversion_level()) * exp(-_model->get_mean_reversion_speed() * time_gap);
-    double s_square = ((v_hat * _model->get_vol_of_vol() * _model->get_vol_of_vol() * exp(-_model->get_mean_reversion_speed() * time_gap)) / _model->get_mean_reversion_speed())
-        * (1. - exp(-_model->get_mean_reversion_speed() * time_gap)) +
-        (_model->get_mean_reversion_level() * _model->get_vol_of_vol() * _model->get_vol_of_vol() *
-        (1. - exp(-_model->get_mean_reversion_speed() * time_gap)) * (1 - exp(-_model->get_mean_reversion_speed() * time_gap)))
-        / (2. * _model->get_mean_reversion_speed());
+    // Continued fraction 1 / (2 (nu + 1) / z + 1 / (2 (nu + 2) / z + ...)), evaluated with the modified Lentz method
+    const double tiny = 1e-300;
+    double f = 2. * (nu + 1.) / z;
+    double C = f, D = 0.;
+    for (int k = 2; k < 10000; ++k) {
+        double b = 2. * (nu + k) / z;
+        D = b + D;
+        if (D == 0.) D = tiny;
+        C = b + 1. / C;
+        if (C == 0.) C = tiny;
+        D = 1. / D;
+        double delta = C * D;
+        f *= delta;
+        if (fabs(delta - 1.) < 1e-15)
+            break;
+    }
+    return 1. / f;
+}
 
-    double psi = s_square / (m * m);
+// Sums over n >= 1 of 1 / (n^2 + a^2), 1 / (n^2 + a^2)^2, n^2 / (n^2 + a^2)^2 and n^2 / (n^2 + a^2)^3
+static void gammaExpansionSums(double a, double& t1, double& t2, double& u2, double& u3)
+{
+    double x = PI * a;
+    if (a < 0.5) {
+        // Power series in a^2 with zeta values: the closed forms below cancel badly for small steps
+        t1 = t2 = u2 = u3 = 0.;
+        double power = 1.;
+        for (int k = 0; k < 200; ++k) {
+            double zeta2 = std::riemann_zeta(2. * k + 2.), zeta4 = std::riemann_zeta(2. * k + 4.);
+            double term = power * zeta4 * (k + 1.) * (k + 2.) * 0.5;
+            t1 += power * zeta2;
+            t2 += power * zeta4 * (k + 1.);
+            u2 += power * zeta2 * (k + 1.);
+            u3 += term;
+            power *= -a * a;
+            if (fabs(term) < 1e-18 * fabs(u3))
+                break;
+        }
+        return;
+    }
 
-    double fMu = gridFunc.functionMu(psi, _gridMu);
-    double fSigma = gridFunc.functionSigma(psi, _gridSigma);
+    double coth = 1. / tanh(x);
+    double csch_square = 1. / (sinh(x) * sinh(x));
+    t1 = (x * coth - 1.) / (2. * a * a);
+    t2 = (x * x * csch_square + x * coth - 2.) / (4. * a * a * a * a);
+    u2 = t1 - a * a * t2;
+    u3 = PI * PI * PI * PI / 16. * (coth / (x * x * x) + csch_square / (x * x) - 2. * coth * csch_square / x);
+}
 
-    double mu = fMu * m;
-    double sigma = fSigma * sqrt(s_square);
-    double v_hat_delta = mu + sigma * randomNormal;
-    if (v_hat_delta < 0.) v_hat_delta = 0.;
-    return v_hat_delta;
+schemaIG::schemaIG(Pair initial_factors,
+    const Vector& time_points,
+    const double psiC,
+    const Model2D& model) :
+    schemaQE(initial_factors, time_points, psiC, model)
+{
+    double kappa = model.get_mean_reversion_speed();
+    double theta = model.get_mean_reversion_level();
+    double sigma = model.get_vol_of_vol();
+    double rho = model.get_correlation();
+
+    _half_dimension = 2. * kappa * theta / (sigma * sigma);
+    _bessel_order = _half_dimension - 1.;
+    _rho_over_sigma = rho / sigma;
+    _integral_coefficient = kappa * _rho_over_sigma - 0.5;
+    _orthogonal_weight = 1. - rho * rho;
+
+    buildSteps();
+}
+
+void schemaIG::setTimePoints(const Vector& time_points)
+{
+    schema::setTimePoints(time_points);
+    buildSteps();
+}
+
+void schemaIG::buildSteps()
+{
+    double kappa = getModel()->get_mean_reversion_speed();
+    double sigma = getModel()->get_vol_of_vol();
+
+    // The terms of the expansion have rates gamma_n = (kappa^2 dt^2 + 4 pi^2 n^2) / (2 sigma^2 dt^2)
+    // and Poisson intensities (v + v_delta) * lambda_n, lambda_n = 16 pi^2 n^2 / (sigma^2 dt (kappa^2 dt^2 + 4 pi^2 n^2))
+    const Vector& time_points = getTimePoints();
+    _steps.clear();
+    for (size_t index = 0; index + 1 < time_points.size(); ++index) {
+        double dt = time_points[index + 1] - time_points[index];
+        double a = kappa * dt / (2. * PI);
+        double t1, t2, u2, u3;
+        gammaExpansionSums(a, t1, t2, u2, u3);
+
+        IntegratedVarianceStep step;
+        step.mean_x1 = 2. * dt / (PI * PI) * u2;
+        step.variance_x1 = 2. * sigma * sigma * dt * dt * dt / (PI * PI * PI * PI) * u3;
+        step.mean_gamma = sigma * sigma * dt * dt / (2. * PI * PI) * t1;
+        step.variance_gamma = sigma * sigma * sigma * sigma * dt * dt * dt * dt / (4. * PI * PI * PI * PI) * t2;
+        step.bessel_factor = 2. * kappa / (sigma * sigma * sinh(0.5 * kappa * dt));
+        _steps.push_back(step);
+    }
 }
 
-// TODO: Cache exponentials to gain speed, and check the speed of the TG Schema
\ No newline at end of file
+schemaIG* schemaIG::clone() const
+{
+    return new schemaIG(*this);
+}
+
+bool schemaIG::samplesIntegratedVariance() const
+{
+    return true;
+}
+
+void schemaIG::integratedVarianceMoments(int current_index, double v, double v_delta, double& mean, double& variance) const
+{
+    const IntegratedVarianceStep& step = _steps[current_index];
+
+    // Moments of eta, of Bessel law with order nu and argument z
+    double mean_eta = 0., variance_eta = 0.;
+    double z = step.bessel_factor * sqrt(v * v_delta);
+    if (z > 0.) {
+        double r1 = besselRatio(_bessel_order, z);
+        double r2 = 1. - 2. * (_bessel_order + 1.) * r1 / z;		// I_{nu+2} / I_nu by the recurrence
+        mean_eta = 0.5 * z * r1;
+        variance_eta = std::max(0.25 * z * z * (r2 - r1 * r1) + mean_eta, 0.);
+    }
+
+    // Each Z is the gamma series with shape 2
+    mean = (v + v_delta) * step.mean_x1 + (_half_dimension + 2. * mean_eta) * step.mean_gamma;
+    variance = (v + v_delta) * step.variance_x1 + (_half_dimension + 2. * mean_eta) * step.variance_gamma
+        + variance_eta * 4. * step.mean_gamma * step.mean_gamma;
+}
+
+double schemaIG::integratedVariance(int current_index, double v, double v_delta, double normal, double uniform) const
+{
+    double mean, variance;
+    integratedVarianceMoments(current_index, v, v_delta, mean, variance);
+    if (!(variance > 0.) || !(mean > 0.))
+        return std::max(mean, 0.);
+
+    // Smaller root of the inverse Gaussian quadratic, written without cancellation
+    double shape = mean * mean * mean / variance;
+    double phi = mean * normal * normal / (2. * shape);
+    double x = mean / (1. + phi + sqrt(phi * (phi + 2.)));
+    return (uniform * (mean + x) <= mean) ? x : mean * mean / x;
+}
+
+double schemaIG::nextStepSpot(double v_delta, int current_index, Pair current_factors, RandomEngine& engine) const
+{
+    // The spot normal first: it is the second normal of the step, the spot one of the quasi random and coupled engines
+    double v = current_factors.second;
+    double randomNormal = engine.normalRandom();
+    double normal_integrated = engine.normalRandom();
+    double uniform_integrated = engine.uniformRandom();
+
+    const StepCoefficients& step = getStepPlan().getStep(current_index);
+    double integrated = integratedVariance(current_index, v, v_delta, normal_integrated, uniform_integrated);
+    double log_spot_delta = log(current_factors.first) + step.K0 + _rho_over_sigma * (v_delta - v)
+        + _integral_coefficient * integrated + sqrt(_orthogonal_weight * integrated) * randomNormal;
+    return exp(log_spot_delta);
+}
+
+void schemaIG::nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+    const double* integrated_normals, const double* integrated_uniforms, const double* normals, double* log_spots, size_t n) const {
+    const StepCoefficients& step = getStepPlan().getStep(current_index);
+    for (size_t i = 0; i < n; ++i) {
+        double v = variances[i];
+        double v_delta = next_variances[i];
+        double integrated = integratedVariance(current_index, v, v_delta, integrated_normals[i], integrated_uniforms[i]);
+        log_spots[i] += step.K0 + _rho_over_sigma * (v_delta - v) + _integral_coefficient * integrated
+            + sqrt(_orthogonal_weight * integrated) * normals[i];
+    }
+}
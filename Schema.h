@@ -6,6 +6,10 @@
 #include <vector>
 #include <cmath>
 #include "GridFunction.h"
+#include "RandomEngine.h"
+#include "PricingContext.h"
+#include "StepPlan.h"
+#include "TGGridCache.h"
 
 using Vector = std::vector<double>;
 using Pair = std::pair<double, double>;
@@ -18,27 +22,49 @@ public:
 		const Vector& time_points,
 		const Model2D& model);
 
-	// Copy constructor, Assignement operator and Destructor are NEEDED because one of the member variable is a POINTER
-	schema(const schema& schema);
+	// The copies share the context of the schema (model, time points and step constants), which never changes
 	virtual schema* clone() const = 0;
-	schema& operator=(const schema& schema);
+	// Same schema on another time grid (the multilevel estimators refine the grid of a schema)
+	schema* cloneWithTimePoints(const Vector& time_points) const;
 
-	virtual ~schema();
+	virtual ~schema() = default;
 
 	Pair getInitialFactors() const;
-	Vector getTimePoints() const;
+	const Vector& getTimePoints() const;
 	const Model2D* getModel() const;
-	virtual double nextStepVolatility(int current_index, Pair current_factors) const = 0;
+	const StepPlan& getStepPlan() const;
+	const std::shared_ptr<const PricingContext>& getContext() const;
+	// The draws are taken from the given engine, or from the engine of the calling thread when none is given
+	double nextStepVolatility(int current_index, Pair current_factors) const;
+	virtual double nextStepVolatility(int current_index, Pair current_factors, RandomEngine& engine) const = 0;
 	double nextStepSpot(double v_delta, int current_index, Pair current_factors) const;
+	// Trapezoidal rule for the integrated variance over the step, one normal drawn
+	virtual double nextStepSpot(double v_delta, int current_index, Pair current_factors, RandomEngine& engine) const;
+
+	// Batch versions, advancing n paths stored as arrays (structure of arrays) with the draws already generated.
+	// The loops have no branch and no virtual call, so the compiler can vectorize them.
+	virtual void nextStepVolatilityBatch(int current_index, const double* variances, const double* normals,
+		const double* uniforms, double* next_variances, size_t n) const = 0;
+	void nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+		const double* normals, double* log_spots, size_t n) const;
+
+	// True if the spot step samples the integrated variance of the step: after the spot normal, it draws a normal and a uniform
+	// for it before the normal of the spot, and the batch simulators give them to the version below
+	virtual bool samplesIntegratedVariance() const;
+	// By default the integrated variance draws are ignored and the trapezoidal version above is used
+	virtual void nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+		const double* integrated_normals, const double* integrated_uniforms, const double* normals, double* log_spots, size_t n) const;
 protected:
+	// Moves the schema to another time grid, recomputing its constants of every step
+	virtual void setTimePoints(const Vector& time_points);
 
 	Pair _initial_factors;
-	Vector _time_points;
-	const Model2D* _model;
+	// Model, time points and constants of every step, computed once and shared by the copies
+	std::shared_ptr<const PricingContext> _context;
 
 };
 
-class schemaQE final : public schema
+class schemaQE : public schema
 {
 public:
 	schemaQE(Pair initial_factors,
@@ -48,7 +74,10 @@ public:
 
 	schemaQE* clone() const override;
 	double getPsiC() const;
-	double nextStepVolatility(int current_index, Pair current_factors) const override;
+	using schema::nextStepVolatility;
+	double nextStepVolatility(int current_index, Pair current_factors, RandomEngine& engine) const override;
+	void nextStepVolatilityBatch(int current_index, const double* variances, const double* normals,
+		const double* uniforms, double* next_variances, size_t n) const override;
 
 private:
 	const double _psiC;
@@ -57,6 +86,7 @@ private:
 class schemaTG final : public schema
 {
 public:
+	// Throws std::runtime_error if the grids cannot be solved on the interval of psi (see TGGridCache::get)
 	schemaTG(Pair initial_factors,
 		const Vector& time_points,
 		const Model2D& model,
@@ -64,14 +94,68 @@ public:
 		int number_points);
 
 	schemaTG* clone() const override;
-	double nextStepVolatility(int current_index, Pair current_factors) const override;
+	const TGGrids& getGrids() const;
+	using schema::nextStepVolatility;
+	double nextStepVolatility(int current_index, Pair current_factors, RandomEngine& engine) const override;
+	void nextStepVolatilityBatch(int current_index, const double* variances, const double* normals,
+		const double* uniforms, double* next_variances, size_t n) const override;
 
 private:
 
 	const Pair _interval;
 	const int _number_points;
-	Vector_Pair _gridR;
-	Vector_Pair _gridMu;
-	Vector_Pair _gridSigma;
+	// Grids of r, mu and sigma, shared with every schema using the same interval and number of points
+	std::shared_ptr<const TGGrids> _grids;
 
 };
+
+// Large step schema: QE for the variance at the end of the step, then the integrated variance sampled conditionally on
+// both ends of the step instead of the trapezoidal rule. Its conditional law (Broadie and Kaya) is approximated by an
+// inverse Gaussian law with the same mean and variance, both known exactly from the gamma expansion of Glasserman and Kim:
+// integrated variance = X1 + X2 + sum of eta copies of Z, where eta has a Bessel law. The log spot then follows
+// log S(t + dt) = log S(t) + rho / sigma * (v_delta - v - kappa * theta * dt) + (kappa * rho / sigma - 0.5) * IV + sqrt((1 - rho^2) * IV) * Z,
+// which stays accurate with steps of a month or more.
+class schemaIG final : public schemaQE
+{
+public:
+	schemaIG(Pair initial_factors,
+		const Vector& time_points,
+		const double psiC,
+		const Model2D& model);
+
+	schemaIG* clone() const override;
+	using schema::nextStepSpot;
+	double nextStepSpot(double v_delta, int current_index, Pair current_factors, RandomEngine& engine) const override;
+	bool samplesIntegratedVariance() const override;
+	using schema::nextStepLogSpotBatch;
+	void nextStepLogSpotBatch(int current_index, const double* variances, const double* next_variances,
+		const double* integrated_normals, const double* integrated_uniforms, const double* normals, double* log_spots, size_t n) const override;
+
+	// Mean and variance of the integrated variance over the step, given the variances at both ends
+	void integratedVarianceMoments(int current_index, double v, double v_delta, double& mean, double& variance) const;
+
+protected:
+	void setTimePoints(const Vector& time_points) override;
+
+private:
+	void buildSteps();
+	// Inverse Gaussian draw with the conditional moments, from a normal and a uniform (Michael, Schucany and Haas)
+	double integratedVariance(int current_index, double v, double v_delta, double normal, double uniform) const;
+
+	// Constants of the gamma expansion for one step
+	struct IntegratedVarianceStep
+	{
+		double mean_x1;			// E[X1] / (v + v_delta)
+		double variance_x1;		// Var[X1] / (v + v_delta)
+		double mean_gamma;		// mean of the gamma series with shape 1
+		double variance_gamma;	// variance of the gamma series with shape 1
+		double bessel_factor;	// argument of the Bessel law / sqrt(v * v_delta)
+	};
+
+	std::vector<IntegratedVarianceStep> _steps;
+	double _half_dimension;		// delta / 2 = 2 * kappa * theta / sigma^2
+	double _bessel_order;		// delta / 2 - 1
+	double _rho_over_sigma;
+	double _integral_coefficient;	// kappa * rho / sigma - 0.5
+	double _orthogonal_weight;		// 1 - rho^2
+};
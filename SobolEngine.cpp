@@ -0,0 +1,207 @@
+#include "SobolEngine.h"
+
+#include <cmath>
+#include <limits>
+
+// Primitive polynomials and initial direction numbers of Joe and Kuo (new-joe-kuo-6.21201) for the dimensions 2 to 32:
+// degree s, coefficients a, then the s initial direction numbers m_1 ... m_s. The first dimension is the van der Corput sequence.
+struct SobolPolynomial
+{
+	unsigned int degree;
+	unsigned int coefficients;
+	unsigned int initial[7];
+};
+
+static const SobolPolynomial JOE_KUO[SobolEngine::MAXIMUM_DIMENSION - 1] = {
+	{ 1, 0, { 1 } },
+	{ 2, 1, { 1, 3 } },
+	{ 3, 1, { 1, 3, 1 } },
+	{ 3, 2, { 1, 1, 1 } },
+	{ 4, 1, { 1, 1, 3, 3 } },
+	{ 4, 4, { 1, 3, 5, 13 } },
+	{ 5, 2, { 1, 1, 5, 5, 17 } },
+	{ 5, 4, { 1, 1, 5, 5, 5 } },
+	{ 5, 7, { 1, 1, 7, 11, 19 } },
+	{ 5, 11, { 1, 1, 5, 1, 1 } },
+	{ 5, 13, { 1, 1, 1, 3, 11 } },
+	{ 5, 14, { 1, 3, 5, 5, 31 } },
+	{ 6, 1, { 1, 3, 3, 9, 7, 49 } },
+	{ 6, 13, { 1, 1, 1, 15, 21, 21 } },
+	{ 6, 16, { 1, 3, 1, 13, 27, 49 } },
+	{ 6, 19, { 1, 1, 1, 15, 7, 5 } },
+	{ 6, 22, { 1, 3, 1, 15, 13, 25 } },
+	{ 6, 25, { 1, 1, 5, 5, 19, 61 } },
+	{ 7, 1, { 1, 3, 7, 11, 23, 15, 103 } },
+	{ 7, 4, { 1, 3, 7, 13, 13, 15, 69 } },
+	{ 7, 7, { 1, 1, 3, 13, 7, 35, 63 } },
+	{ 7, 8, { 1, 3, 5, 9, 1, 25, 53 } },
+	{ 7, 14, { 1, 3, 1, 13, 9, 35, 107 } },
+	{ 7, 19, { 1, 3, 1, 5, 27, 61, 31 } },
+	{ 7, 21, { 1, 1, 5, 11, 19, 41, 61 } },
+	{ 7, 28, { 1, 3, 5, 3, 3, 13, 69 } },
+	{ 7, 31, { 1, 1, 7, 13, 1, 19, 1 } },
+	{ 7, 32, { 1, 3, 7, 5, 13, 19, 59 } },
+	{ 7, 37, { 1, 1, 3, 9, 25, 29, 41 } },
+	{ 7, 41, { 1, 3, 5, 13, 23, 1, 55 } },
+	{ 7, 42, { 1, 3, 7, 3, 13, 59, 17 } }
+};
+
+static const size_t BITS = 32;
+
+BrownianBridge::BrownianBridge(const Vector& time_points) :
+	_path(time_points.size(), 0.)
+{
+	size_t number_of_steps = time_points.size() - 1;
+
+	// The last point first, from the starting point
+	_bridge_index.push_back(number_of_steps);
+	_left_index.push_back(0);
+	_right_index.push_back(0);
+	_left_weight.push_back(1.);
+	_right_weight.push_back(0.);
+	_standard_deviation.push_back(sqrt(time_points[number_of_steps] - time_points[0]));
+
+	// Then the middle of each interval, level after level
+	std::vector<std::pair<size_t, size_t>> intervals{ { 0, number_of_steps } };
+	for (size_t position = 0; position < intervals.size(); ++position) {
+		size_t left = intervals[position].first;
+		size_t right = intervals[position].second;
+		if (right - left < 2)
+			continue;
+		size_t middle = (left + right) / 2;
+		double left_time = time_points[left], middle_time = time_points[middle], right_time = time_points[right];
+
+		_bridge_index.push_back(middle);
+		_left_index.push_back(left);
+		_right_index.push_back(right);
+		_left_weight.push_back((right_time - middle_time) / (right_time - left_time));
+		_right_weight.push_back((middle_time - left_time) / (right_time - left_time));
+		_standard_deviation.push_back(sqrt((middle_time - left_time) * (right_time - middle_time) / (right_time - left_time)));
+
+		intervals.push_back({ left, middle });
+		intervals.push_back({ middle, right });
+	}
+
+	for (size_t index = 0; index < number_of_steps; ++index)
+		_inverse_sqrt_time_gap.push_back(1. / sqrt(time_points[index + 1] - time_points[index]));
+}
+
+size_t BrownianBridge::getNumberOfSteps() const
+{
+	return _inverse_sqrt_time_gap.size();
+}
+
+void BrownianBridge::buildIncrements(const double* normals, double* increments) const
+{
+	_path[0] = 0.;
+	for (size_t k = 0; k < _bridge_index.size(); ++k) {
+		_path[_bridge_index[k]] = _left_weight[k] * _path[_left_index[k]] + _right_weight[k] * _path[_right_index[k]]
+			+ _standard_deviation[k] * normals[k];
+	}
+	for (size_t index = 0; index < _inverse_sqrt_time_gap.size(); ++index)
+		increments[index] = (_path[index + 1] - _path[index]) * _inverse_sqrt_time_gap[index];
+}
+
+SobolEngine::SobolEngine(const Vector& time_points, uint64_t seed) :
+	_bridge(time_points), _padding(seed), _directions(MAXIMUM_DIMENSION * BITS), _shifts(MAXIMUM_DIMENSION),
+	_path_index(0), _step_index(0), _draws_in_step(0), _uniforms_in_step(0),
+	_variance_normals(time_points.size() - 1), _spot_normals(time_points.size() - 1), _inputs(2 * (time_points.size() - 1))
+{
+	// Direction numbers v_k = m_k / 2^k, stored as 32 bits integers
+	for (size_t k = 0; k < BITS; ++k)
+		_directions[k] = 1u << (BITS - 1 - k);
+	for (size_t dimension = 1; dimension < MAXIMUM_DIMENSION; ++dimension) {
+		const SobolPolynomial& polynomial = JOE_KUO[dimension - 1];
+		uint32_t* v = &_directions[dimension * BITS];
+		size_t s = polynomial.degree;
+		for (size_t k = 0; k < s; ++k)
+			v[k] = polynomial.initial[k] << (BITS - 1 - k);
+		for (size_t k = s; k < BITS; ++k) {
+			v[k] = v[k - s] ^ (v[k - s] >> s);
+			for (size_t i = 1; i < s; ++i) {
+				if ((polynomial.coefficients >> (s - 1 - i)) & 1)
+					v[k] ^= v[k - i];
+			}
+		}
+	}
+
+	// The digital shifts come from a path of the Philox stream which is never used for the padding
+	PhiloxEngine shift_engine(seed);
+	shift_engine.skipTo(std::numeric_limits<uint64_t>::max(), 0);
+	for (size_t dimension = 0; dimension < MAXIMUM_DIMENSION; ++dimension)
+		_shifts[dimension] = (uint32_t)(shift_engine.uniformRandom() * 4294967296.);
+
+	generatePath(0);
+}
+
+SobolEngine* SobolEngine::clone() const
+{
+	return new SobolEngine(*this);
+}
+
+void SobolEngine::generatePath(uint64_t path_index)
+{
+	size_t number_of_steps = _bridge.getNumberOfSteps();
+	double* variance_inputs = _inputs.data();
+	double* spot_inputs = _inputs.data() + number_of_steps;
+
+	// Points in Gray code order, as in the algorithm of Antonov and Saleev
+	uint64_t gray = path_index ^ (path_index >> 1);
+	for (size_t dimension = 0; dimension < MAXIMUM_DIMENSION && dimension < 2 * number_of_steps; ++dimension) {
+		uint32_t x = 0;
+		for (size_t k = 0; k < BITS; ++k) {
+			if ((gray >> k) & 1)
+				x ^= _directions[dimension * BITS + k];
+		}
+		double normal = inverseNormalCDF(((double)(x ^ _shifts[dimension]) + 0.5) / 4294967296.);
+		// Even dimensions for the variance, odd dimensions for the spot
+		if (dimension % 2 == 0)
+			variance_inputs[dimension / 2] = normal;
+		else
+			spot_inputs[dimension / 2] = normal;
+	}
+
+	_padding.skipTo(path_index, 0);
+	size_t first_padded = (MAXIMUM_DIMENSION + 1) / 2;
+	if (first_padded < number_of_steps) {
+		_padding.fillNormals(variance_inputs + first_padded, number_of_steps - first_padded);
+		_padding.fillNormals(spot_inputs + first_padded, number_of_steps - first_padded);
+	}
+
+	_bridge.buildIncrements(variance_inputs, _variance_normals.data());
+	_bridge.buildIncrements(spot_inputs, _spot_normals.data());
+	_path_index = path_index;
+}
+
+void SobolEngine::skipTo(uint64_t path_index, uint64_t step_index)
+{
+	if (path_index != _path_index)
+		generatePath(path_index);
+	_step_index = step_index;
+	_draws_in_step = 0;
+	_uniforms_in_step = 0;
+	// The further draws of the step: the padding of a path takes fewer than number_of_steps steps of the stream, the steps after are free
+	_padding.skipTo(path_index, _bridge.getNumberOfSteps() + step_index);
+}
+
+double SobolEngine::normalRandom()
+{
+	size_t draw = _draws_in_step++;
+	if (draw == 0)
+		return _variance_normals[_step_index];
+	if (draw == 1)
+		return _spot_normals[_step_index];
+	return _padding.normalRandom();
+}
+
+double SobolEngine::uniformRandom()
+{
+	if (_uniforms_in_step++ == 0)
+		return 0.5 * erfc(-_variance_normals[_step_index] / sqrt(2.));
+	return _padding.uniformRandom();
+}
+
+void SobolEngine::fillUniforms(double* uniforms, size_t n)
+{
+	_padding.fillUniforms(uniforms, n);
+}
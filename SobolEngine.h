@@ -0,0 +1,74 @@
+#ifndef SOBOLENGINE_H
+#define SOBOLENGINE_H
+
+#include "RandomEngine.h"
+
+#include <vector>
+
+using Vector = std::vector<double>;
+
+// Brownian bridge on a time grid: builds the values of a Brownian motion from independent normals, the first normal giving
+// the last point, the second the middle point, and so on. Most of the variance of the path is then carried by the first normals.
+class BrownianBridge
+{
+public:
+	BrownianBridge(const Vector& time_points);
+
+	size_t getNumberOfSteps() const;
+	// From number_of_steps independent normals (in order of importance) to the number_of_steps normalized increments of the motion
+	void buildIncrements(const double* normals, double* increments) const;
+
+private:
+	// For each normal: the point it builds, the two points it is interpolated from, and the weights of the interpolation
+	std::vector<size_t> _bridge_index;
+	std::vector<size_t> _left_index;
+	std::vector<size_t> _right_index;
+	Vector _left_weight;
+	Vector _right_weight;
+	Vector _standard_deviation;
+	Vector _inverse_sqrt_time_gap;
+	mutable Vector _path;
+};
+
+// Randomized quasi Monte Carlo engine: path i is the point i of a Sobol sequence (Joe and Kuo direction numbers),
+// scrambled by a random digital shift drawn from the seed. Each seed gives an independent replicate of the point set.
+// The normals of the variance and of the spot of a path are built by two Brownian bridges: their most important inputs
+// take the Sobol dimensions (alternately variance and spot), the other inputs are padded with the Philox stream of the seed.
+//
+// Within a step, the first normal drawn is the variance normal, the second one the spot normal. The first uniform draw returns
+// Phi(variance normal), as in the QE schema of Andersen where the same uniform drives both branches. The further draws of a step
+// (the integrated variance of schemaIG) are independent of these: they come from the step number_of_steps + step of the padding
+// stream, which the padding of the path never reaches. The whole path is generated when skipTo() moves to a new path.
+class SobolEngine final : public RandomEngine
+{
+public:
+	static const size_t MAXIMUM_DIMENSION = 32;
+
+	SobolEngine(const Vector& time_points, uint64_t seed);
+	SobolEngine* clone() const override;
+
+	void skipTo(uint64_t path_index, uint64_t step_index) override;
+	double uniformRandom() override;
+	double normalRandom() override;
+	// The block API is not part of the point set, it reads the padding stream of the step
+	void fillUniforms(double* uniforms, size_t n) override;
+
+private:
+	void generatePath(uint64_t path_index);
+
+	BrownianBridge _bridge;
+	PhiloxEngine _padding;
+	// Direction numbers of each dimension, and the digital shift of each dimension
+	std::vector<uint32_t> _directions;
+	std::vector<uint32_t> _shifts;
+
+	uint64_t _path_index;
+	uint64_t _step_index;
+	size_t _draws_in_step;
+	size_t _uniforms_in_step;
+	Vector _variance_normals;
+	Vector _spot_normals;
+	Vector _inputs;
+};
+
+#endif
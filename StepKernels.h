@@ -0,0 +1,65 @@
+#ifndef STEPKERNELS_H
+#define STEPKERNELS_H
+
+#include "StepPlan.h"
+#include "TGGridCache.h"
+
+#include <cmath>
+
+// Step of one path for the schemas, shared by their virtual methods and by the compiled path kernels of PathKernel.h.
+// The engine is a template parameter: called with a final engine class, the draws are inlined with the rest of the step.
+
+// QE variance step: a normal then a uniform are drawn
+template <class Engine>
+inline double stepVarianceQE(const StepCoefficients& step, double psiC, double v_hat, Engine& engine)
+{
+	//We have two independent normal random variables N(0,1)
+	double randomNormal = engine.normalRandom();
+
+	double m = step.m_constant + step.m_slope * v_hat;
+	double s_square = step.s_square_constant + step.s_square_slope * v_hat;
+
+	double psi = s_square / (m * m);
+	double psiInv = 1. / psi;
+	double uV = engine.uniformRandom();
+
+	if (psi <= psiC) {
+		double b_square = 2. * psiInv - 1. + std::sqrt(2. * psiInv) * std::sqrt(2. * psiInv - 1.);
+		double b = std::sqrt(b_square);
+		double a = m / (1. + b_square);
+		return a * (b + randomNormal) * (b + randomNormal);
+	}
+	double p = (psi - 1.) / (psi + 1.);
+	double beta = (1. - p) / m;
+	if (p >= uV && uV >= 0.)
+		return 0.;
+	return (1. / beta) * std::log((1. - p) / (1. - uV));
+}
+
+// TG variance step: one normal is drawn
+template <class Engine>
+inline double stepVarianceTG(const StepCoefficients& step, const TGGrids& grids, double v_hat, Engine& engine)
+{
+	double randomNormal = engine.normalRandom();
+
+	double m = step.m_constant + step.m_slope * v_hat;
+	double s_square = step.s_square_constant + step.s_square_slope * v_hat;
+	double psi = s_square / (m * m);
+
+	double mu = grids.tableMu.evaluate(psi) * m;
+	double sigma = grids.tableSigma.evaluate(psi) * std::sqrt(s_square);
+	double v_hat_delta = mu + sigma * randomNormal;
+	if (v_hat_delta < 0.) v_hat_delta = 0.;
+	return v_hat_delta;
+}
+
+// Log spot step with the trapezoidal rule for the integrated variance: one normal is drawn
+template <class Engine>
+inline double stepLogSpot(const StepCoefficients& step, double log_spot, double v, double v_delta, Engine& engine)
+{
+	double randomNormal = engine.normalRandom();
+	return log_spot + step.K0 + step.K1 * v + step.K2 * v_delta
+		+ std::sqrt(step.K3 * v + step.K4 * v_delta) * randomNormal;
+}
+
+#endif
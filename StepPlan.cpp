@@ -0,0 +1,38 @@
+#include "StepPlan.h"
+
+#include <cmath>
+
+StepPlan::StepPlan(const Model2D& model, const Vector& time_points)
+{
+	double kappa = model.get_mean_reversion_speed();
+	double theta = model.get_mean_reversion_level();
+	double sigma = model.get_vol_of_vol();
+	double rho = model.get_correlation();
+	double rho_over_sigma = rho / sigma;
+
+	for (size_t index = 0; index + 1 < time_points.size(); ++index) {
+		StepCoefficients step;
+		step.time_gap = time_points[index + 1] - time_points[index];
+		step.exponential = exp(-kappa * step.time_gap);
+
+		step.m_constant = theta * (1. - step.exponential);
+		step.m_slope = step.exponential;
+		step.s_square_constant = theta * sigma * sigma * (1. - step.exponential) * (1. - step.exponential) / (2. * kappa);
+		step.s_square_slope = sigma * sigma * step.exponential * (1. - step.exponential) / kappa;
+
+		// Trapezoidal approximation of the integrated variance, with weights 0.5 on each end of the step
+		double integral_coefficient = (kappa * rho_over_sigma - 0.5) * step.time_gap * 0.5;
+		step.K0 = -rho_over_sigma * kappa * theta * step.time_gap;
+		step.K1 = integral_coefficient - rho_over_sigma;
+		step.K2 = integral_coefficient + rho_over_sigma;
+		step.K3 = (1. - rho * rho) * step.time_gap * 0.5;
+		step.K4 = step.K3;
+
+		_steps.push_back(step);
+	}
+}
+
+size_t StepPlan::getNumberOfSteps() const
+{
+	return _steps.size();
+}
@@ -0,0 +1,54 @@
+#ifndef STEPPLAN_H
+#define STEPPLAN_H
+
+#ifndef MODEL2D_H
+#include "Model2D.h"
+#endif
+
+#include <cstddef>
+#include <vector>
+
+using Vector = std::vector<double>;
+
+// Constants of one time step of the schemas, which only depend on the model parameters and on the time gap
+struct StepCoefficients
+{
+	double time_gap;
+	double exponential;			// exp(-kappa * time_gap)
+
+	// Moments of the variance at the end of the step, affine in the current variance v_hat:
+	// m = m_constant + m_slope * v_hat and s_square = s_square_constant + s_square_slope * v_hat
+	double m_constant;
+	double m_slope;
+	double s_square_constant;
+	double s_square_slope;
+
+	// Log spot step: log S(t + dt) = log S(t) + K0 + K1 * v + K2 * v_delta + sqrt(K3 * v + K4 * v_delta) * Z
+	double K0;
+	double K1;
+	double K2;
+	double K3;
+	double K4;
+};
+
+// Coefficients of every step of a time grid, computed once for a (model, time grid):
+// the step kernels only read them, no exponential and no model getter is called while simulating.
+class StepPlan
+{
+public:
+	StepPlan(const Model2D& model, const Vector& time_points);
+
+	// Coefficients of the step from time point current_index to current_index + 1
+	const StepCoefficients& getStep(int current_index) const;
+	size_t getNumberOfSteps() const;
+
+private:
+	std::vector<StepCoefficients> _steps;
+};
+
+inline const StepCoefficients& StepPlan::getStep(int current_index) const
+{
+	return _steps[current_index];
+}
+
+#endif
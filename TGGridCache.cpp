@@ -0,0 +1,181 @@
+#include "TGGridCache.h"
+#include "GridFunction.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+// Layout of a file: the header, then the r, mu and sigma values of the grid (number_points doubles each)
+static const char FILE_MAGIC[8] = { 'V', 'S', 'T', 'G', 'G', 'R', 'I', 'D' };
+static const uint32_t FILE_VERSION = 2;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t number_points;
+	double psi_min;
+	double psi_max;
+};
+
+static std::mutex cache_mutex;
+static std::map<std::pair<Pair, int>, std::shared_ptr<const TGGrids>> memory_cache;
+static bool directory_set = false;
+static std::string cache_directory;
+
+static void buildTables(TGGrids& grids)
+{
+	grids.tableMu = InterpolationTable(grids.gridMu, true);
+	grids.tableSigma = InterpolationTable(grids.gridSigma, true);
+}
+
+static uint64_t bits(double x)
+{
+	uint64_t result;
+	std::memcpy(&result, &x, sizeof(result));
+	return result;
+}
+
+std::shared_ptr<const TGGrids> TGGridCache::get(Pair interval, int number_points)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto key = std::make_pair(interval, number_points);
+	auto found = memory_cache.find(key);
+	if (found != memory_cache.end())
+		return found->second;
+
+	std::shared_ptr<TGGrids> grids = std::make_shared<TGGrids>();
+	std::string file_name = fileName(interval, number_points);
+	if (file_name.empty() || !load(file_name, interval, number_points, *grids)) {
+		gridFunction gridObj(interval, number_points);
+		grids->gridR = gridObj.getGridFunctionR();
+		grids->gridMu = gridObj.getGridFunctionMu();
+		grids->gridSigma = gridObj.getGridFunctionSigma();
+		// Incomplete grids would be extrapolated flat, the prices would be wrong
+		if (gridObj.getStatus() != RootSolverStatus::SUCCESS)
+			throw std::runtime_error("TGGridCache: the grid of r could not be solved on this interval of psi");
+		if (!file_name.empty())
+			save(file_name, interval, number_points, *grids);
+	}
+	buildTables(*grids);
+
+	memory_cache[key] = grids;
+	return grids;
+}
+
+void TGGridCache::setDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache_directory = directory;
+	directory_set = true;
+}
+
+// cache_mutex must be held
+static std::string cacheDirectory()
+{
+	if (!directory_set) {
+		const char* environment = std::getenv("VARSWAP_CACHE_DIR");
+		std::error_code error;
+		if (environment != nullptr)
+			cache_directory = environment;
+		else
+			cache_directory = (std::filesystem::temp_directory_path(error) / "varswap_cache").string();
+		directory_set = true;
+	}
+	return cache_directory;
+}
+
+std::string TGGridCache::getDirectory()
+{
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return cacheDirectory();
+}
+
+// The bounds are written with their bit patterns, so two intervals share a file only if they are exactly equal
+// Called by get, with cache_mutex held
+std::string TGGridCache::fileName(Pair interval, int number_points)
+{
+	std::string directory = cacheDirectory();
+	if (directory.empty())
+		return "";
+
+	char name[128];
+	std::snprintf(name, sizeof(name), "tg_grid_v%u_%016llx_%016llx_%d.bin", FILE_VERSION,
+		(unsigned long long)bits(interval.first), (unsigned long long)bits(interval.second), number_points);
+	return (std::filesystem::path(directory) / name).string();
+}
+
+static bool readGrids(const char* data, size_t size, Pair interval, int number_points, TGGrids& grids)
+{
+	FileHeader header;
+	size_t expected_size = sizeof(FileHeader) + 3 * (size_t)number_points * sizeof(double);
+	if (size != expected_size)
+		return false;
+	std::memcpy(&header, data, sizeof(FileHeader));
+	if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION
+		|| header.number_points != (uint32_t)number_points || header.psi_min != interval.first || header.psi_max != interval.second)
+		return false;
+
+	const char* values = data + sizeof(FileHeader);
+	Vector_Pair* target_grids[3] = { &grids.gridR, &grids.gridMu, &grids.gridSigma };
+	for (int grid_index = 0; grid_index < 3; ++grid_index) {
+		target_grids[grid_index]->resize(number_points);
+		for (int i = 0; i < number_points; ++i) {
+			double psi = interval.first + (double)i * (interval.second - interval.first) / ((double)number_points - 1);
+			double value;
+			std::memcpy(&value, values + ((size_t)grid_index * number_points + i) * sizeof(double), sizeof(double));
+			(*target_grids[grid_index])[i] = { psi, value };
+		}
+	}
+	return true;
+}
+
+// The grids are copied out of the file (psi is not stored), so the file is simply read
+bool TGGridCache::load(const std::string& file_name, Pair interval, int number_points, TGGrids& grids)
+{
+	std::ifstream file(file_name, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return readGrids(content.data(), content.size(), interval, number_points, grids);
+}
+
+// The file is written under a temporary name and then renamed, so another process never reads a partial file
+void TGGridCache::save(const std::string& file_name, Pair interval, int number_points, const TGGrids& grids)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(file_name).parent_path(), error);
+
+	FileHeader header;
+	std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.number_points = (uint32_t)number_points;
+	header.psi_min = interval.first;
+	header.psi_max = interval.second;
+
+	std::string temporary_name = file_name + ".tmp" + std::to_string(std::random_device()());
+	{
+		std::ofstream file(temporary_name, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+		file.write((const char*)&header, sizeof(header));
+		const Vector_Pair* source_grids[3] = { &grids.gridR, &grids.gridMu, &grids.gridSigma };
+		for (const Vector_Pair* grid : source_grids) {
+			for (const auto& point : *grid)
+				file.write((const char*)&point.second, sizeof(double));
+		}
+		if (!file)
+			return;
+	}
+	std::filesystem::rename(temporary_name, file_name, error);
+	if (error)
+		std::filesystem::remove(temporary_name, error);
+}
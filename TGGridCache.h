@@ -0,0 +1,44 @@
+#ifndef TGGRIDCACHE_H
+#define TGGRIDCACHE_H
+
+#include "InterpolationTable.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Pair = std::pair<double, double>;
+using Vector_Pair = std::vector<std::pair<double, double>>;
+
+// Grids of the functions r, mu and sigma of the TG schema, for one (interval, number_points).
+// They never change once built, so one object is shared by every schema using the same grids.
+struct TGGrids
+{
+	Vector_Pair gridR;
+	Vector_Pair gridMu;
+	Vector_Pair gridSigma;
+	InterpolationTable tableMu;
+	InterpolationTable tableSigma;
+};
+
+// Cache of the TG grids, in memory for the process and on disk between processes.
+// The files are versioned binaries keyed by (interval, number_points).
+// If a file is missing or does not match, the grids are solved with gridFunction and the file is written again.
+// get throws std::runtime_error if the grids cannot be solved: nothing is cached, and the schemaTG being built is not created.
+class TGGridCache
+{
+public:
+	static std::shared_ptr<const TGGrids> get(Pair interval, int number_points);
+
+	// Directory of the files, by default $VARSWAP_CACHE_DIR or the temporary directory. An empty string disables the disk cache.
+	static void setDirectory(const std::string& directory);
+	static std::string getDirectory();
+
+private:
+	static std::string fileName(Pair interval, int number_points);
+	static bool load(const std::string& file_name, Pair interval, int number_points, TGGrids& grids);
+	static void save(const std::string& file_name, Pair interval, int number_points, const TGGrids& grids);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef TAYLORJET_H
+#define TAYLORJET_H
+
+#include <cmath>
+#include <cstddef>
+
+// Forward mode automatic differentiation up to the second order:
+// a Jet holds the value and the first two derivatives of a function of one variable at a given point.
+// The scalar type T is usually double, but can itself be a differentiable type.
+template <class T>
+struct Jet
+{
+	T value;
+	T first;
+	T second;
+
+	Jet() : value(0.), first(0.), second(0.) {}
+	Jet(T constant) : value(constant), first(0.), second(0.) {}
+	Jet(T value_, T first_, T second_) : value(value_), first(first_), second(second_) {}
+
+	// The variable itself at the point x
+	static Jet variable(T x) { return Jet(x, T(1.), T(0.)); }
+};
+
+template <class T>
+Jet<T> operator+(const Jet<T>& u, const Jet<T>& v) { return Jet<T>(u.value + v.value, u.first + v.first, u.second + v.second); }
+template <class T>
+Jet<T> operator-(const Jet<T>& u, const Jet<T>& v) { return Jet<T>(u.value - v.value, u.first - v.first, u.second - v.second); }
+template <class T>
+Jet<T> operator-(const Jet<T>& u) { return Jet<T>(-u.value, -u.first, -u.second); }
+
+template <class T>
+Jet<T> operator*(const Jet<T>& u, const Jet<T>& v)
+{
+	return Jet<T>(u.value * v.value, u.first * v.value + u.value * v.first,
+		u.second * v.value + 2. * u.first * v.first + u.value * v.second);
+}
+
+template <class T>
+Jet<T> operator/(const Jet<T>& u, const Jet<T>& v)
+{
+	T quotient = u.value / v.value;
+	T first = (u.first - quotient * v.first) / v.value;
+	return Jet<T>(quotient, first, (u.second - 2. * first * v.first - quotient * v.second) / v.value);
+}
+
+template <class T>
+Jet<T> exp(const Jet<T>& u)
+{
+	using std::exp;
+	T value = exp(u.value);
+	return Jet<T>(value, value * u.first, value * (u.second + u.first * u.first));
+}
+
+template <class T>
+Jet<T> log(const Jet<T>& u)
+{
+	using std::log;
+	return Jet<T>(log(u.value), u.first / u.value, (u.second * u.value - u.first * u.first) / (u.value * u.value));
+}
+
+template <class T>
+Jet<T> sqrt(const Jet<T>& u)
+{
+	using std::sqrt;
+	T value = sqrt(u.value);
+	T first = u.first / (2. * value);
+	return Jet<T>(value, first, (u.second - 2. * first * first) / (2. * value));
+}
+
+// Forward mode automatic differentiation at the first order in N variables: the value and the gradient of a function.
+// Used as the scalar of a Jet, it gives the derivatives of the Jet in the N variables.
+template <size_t N>
+struct Dual
+{
+	double value;
+	double gradient[N];
+
+	Dual() : Dual(0.) {}
+	Dual(double constant) : value(constant) { for (size_t k = 0; k < N; ++k) gradient[k] = 0.; }
+
+	// The variable of the given index at the point x
+	static Dual variable(double x, size_t index) { Dual u(x); u.gradient[index] = 1.; return u; }
+};
+
+template <size_t N>
+Dual<N> operator+(const Dual<N>& u, const Dual<N>& v)
+{
+	Dual<N> w(u.value + v.value);
+	for (size_t k = 0; k < N; ++k) w.gradient[k] = u.gradient[k] + v.gradient[k];
+	return w;
+}
+template <size_t N>
+Dual<N> operator-(const Dual<N>& u, const Dual<N>& v)
+{
+	Dual<N> w(u.value - v.value);
+	for (size_t k = 0; k < N; ++k) w.gradient[k] = u.gradient[k] - v.gradient[k];
+	return w;
+}
+template <size_t N>
+Dual<N> operator-(const Dual<N>& u) { return Dual<N>(0.) - u; }
+
+template <size_t N>
+Dual<N> operator*(const Dual<N>& u, const Dual<N>& v)
+{
+	Dual<N> w(u.value * v.value);
+	for (size_t k = 0; k < N; ++k) w.gradient[k] = u.gradient[k] * v.value + u.value * v.gradient[k];
+	return w;
+}
+
+template <size_t N>
+Dual<N> operator/(const Dual<N>& u, const Dual<N>& v)
+{
+	Dual<N> w(u.value / v.value);
+	for (size_t k = 0; k < N; ++k) w.gradient[k] = (u.gradient[k] - w.value * v.gradient[k]) / v.value;
+	return w;
+}
+
+template <size_t N>
+Dual<N> operator+(double u, const Dual<N>& v) { return Dual<N>(u) + v; }
+template <size_t N>
+Dual<N> operator-(double u, const Dual<N>& v) { return Dual<N>(u) - v; }
+template <size_t N>
+Dual<N> operator*(double u, const Dual<N>& v) { return Dual<N>(u) * v; }
+template <size_t N>
+Dual<N> operator/(double u, const Dual<N>& v) { return Dual<N>(u) / v; }
+
+// Chain rule with the derivative f' of the function at the value of u
+template <size_t N>
+Dual<N> chain(double value, double derivative, const Dual<N>& u)
+{
+	Dual<N> w(value);
+	for (size_t k = 0; k < N; ++k) w.gradient[k] = derivative * u.gradient[k];
+	return w;
+}
+
+template <size_t N>
+Dual<N> exp(const Dual<N>& u) { double value = std::exp(u.value); return chain(value, value, u); }
+template <size_t N>
+Dual<N> log(const Dual<N>& u) { return chain(std::log(u.value), 1. / u.value, u); }
+template <size_t N>
+Dual<N> sqrt(const Dual<N>& u) { double value = std::sqrt(u.value); return chain(value, 0.5 / value, u); }
+
+#endif
@@ -0,0 +1,238 @@
+#include "TradeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+const char TradeReader::BINARY_MAGIC[4] = { 'V', 'S', 'W', 'T' };
+const uint32_t TradeReader::BINARY_VERSION;
+const size_t TradeReader::UNDERLYING_SIZE;
+
+static const size_t NUMBER_OF_CSV_COLUMNS = 16;
+
+static bool parseDouble(const std::string& text, double& value)
+{
+	char* end = nullptr;
+	value = std::strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0';
+}
+
+static bool parseInteger(const std::string& text, uint64_t& value)
+{
+	char* end = nullptr;
+	value = std::strtoull(text.c_str(), &end, 10);
+	return !text.empty() && *end == '\0';
+}
+
+static bool parseContract(const std::string& text, ContractType& contract)
+{
+	if (text == "variance") contract = ContractType::VarianceSwap;
+	else if (text == "volatility") contract = ContractType::VolatilitySwap;
+	else if (text == "capped") contract = ContractType::CappedVarianceSwap;
+	else if (text == "corridor") contract = ContractType::CorridorVarianceSwap;
+	else return false;
+	return true;
+}
+
+// Fixed size fields of the binary records, in the order of the record
+template <class T>
+static bool readField(std::ifstream& file, T& value)
+{
+	return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Field of a record read in memory, the position moving to the next field
+template <class T>
+static void decodeField(const char*& position, T& value)
+{
+	std::memcpy(&value, position, sizeof(T));
+	position += sizeof(T);
+}
+
+// id, underlying, 8 market doubles, number_of_dates, contract, is_call, 3 contract doubles
+static const size_t BINARY_RECORD_SIZE = sizeof(uint64_t) + TradeReader::UNDERLYING_SIZE + 8 * sizeof(double) + sizeof(uint32_t)
+	+ 2 * sizeof(uint8_t) + 3 * sizeof(double);
+
+template <class T>
+static void writeField(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+TradeReader::TradeReader(const std::string& file_name) :
+	_file(file_name, std::ios::binary), _binary(false), _record_number(0)
+{
+	char magic[4] = { 0, 0, 0, 0 };
+	uint32_t version = 0;
+	if (_file.read(magic, 4) && std::memcmp(magic, BINARY_MAGIC, 4) == 0) {
+		_binary = readField(_file, version) && version == BINARY_VERSION;
+		if (!_binary) {
+			std::cerr << file_name << ": unsupported binary version " << version << "\n";
+			_file.close();
+		}
+		return;
+	}
+
+	// CSV: back to the start, and the header line is skipped
+	_file.clear();
+	_file.seekg(0);
+	std::string header;
+	std::getline(_file, header);
+	_record_number = 1;
+}
+
+bool TradeReader::isOpen() const
+{
+	return _file.is_open();
+}
+
+bool TradeReader::next(Trade& trade)
+{
+	if (!_file.is_open())
+		return false;
+	return _binary ? nextBinary(trade) : nextCSV(trade);
+}
+
+bool parseTrade(const std::string& line, Trade& trade)
+{
+	std::vector<std::string> columns;
+	size_t start = 0;
+	for (size_t comma = line.find(','); comma != std::string::npos; comma = line.find(',', start)) {
+		columns.push_back(line.substr(start, comma - start));
+		start = comma + 1;
+	}
+	columns.push_back(line.substr(start));
+
+	uint64_t number_of_dates = 0, is_call = 0;
+	bool valid = columns.size() == NUMBER_OF_CSV_COLUMNS
+		&& parseInteger(columns[0], trade.id)
+		&& parseDouble(columns[2], trade.spot)
+		&& parseDouble(columns[3], trade.initial_variance)
+		&& parseDouble(columns[4], trade.mean_reversion_speed)
+		&& parseDouble(columns[5], trade.mean_reversion_level)
+		&& parseDouble(columns[6], trade.vol_of_vol)
+		&& parseDouble(columns[7], trade.correlation)
+		&& parseDouble(columns[8], trade.rate)
+		&& parseDouble(columns[9], trade.maturity)
+		&& parseInteger(columns[10], number_of_dates)
+		&& parseContract(columns[11], trade.contract)
+		&& parseInteger(columns[12], is_call)
+		&& parseDouble(columns[13], trade.strike)
+		&& parseDouble(columns[14], trade.parameter1)
+		&& parseDouble(columns[15], trade.parameter2)
+		&& number_of_dates <= MAXIMUM_NUMBER_OF_DATES;
+	if (!valid)
+		return false;
+	trade.underlying = columns[1];
+	trade.number_of_dates = (uint32_t)number_of_dates;
+	trade.is_call = (is_call != 0);
+	return isValidTrade(trade);
+}
+
+bool isValidTrade(const Trade& trade)
+{
+	// Finite numbers only: NaN would also break the order of the groups of trades
+	const double values[] = { trade.spot, trade.initial_variance, trade.mean_reversion_speed, trade.mean_reversion_level, trade.vol_of_vol,
+		trade.correlation, trade.rate, trade.maturity, trade.strike, trade.parameter1, trade.parameter2 };
+	for (double value : values)
+		if (!std::isfinite(value))
+			return false;
+
+	return trade.spot > 0. && trade.initial_variance >= 0. && trade.mean_reversion_speed > 0. && trade.mean_reversion_level > 0.
+		&& trade.vol_of_vol > 0. && std::fabs(trade.correlation) < 1. && trade.maturity > 0.
+		&& trade.number_of_dates > 0 && trade.number_of_dates <= MAXIMUM_NUMBER_OF_DATES
+		&& (uint8_t)trade.contract <= (uint8_t)ContractType::CorridorVarianceSwap
+		&& (trade.contract != ContractType::CorridorVarianceSwap || trade.parameter1 < trade.parameter2);
+}
+
+bool TradeReader::nextCSV(Trade& trade)
+{
+	std::string line;
+	while (std::getline(_file, line)) {
+		++_record_number;
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty())
+			continue;
+		if (parseTrade(line, trade))
+			return true;
+		std::cerr << "Line " << _record_number << ": invalid trade, skipped\n";
+	}
+	return false;
+}
+
+bool TradeReader::nextBinary(Trade& trade)
+{
+	char record[BINARY_RECORD_SIZE];
+	while (_file.read(record, BINARY_RECORD_SIZE)) {
+		++_record_number;
+		const char* position = record;
+		char underlying[UNDERLYING_SIZE];
+		uint8_t contract = 0, is_call = 0;
+		decodeField(position, trade.id);
+		std::memcpy(underlying, position, UNDERLYING_SIZE);
+		position += UNDERLYING_SIZE;
+		decodeField(position, trade.spot);
+		decodeField(position, trade.initial_variance);
+		decodeField(position, trade.mean_reversion_speed);
+		decodeField(position, trade.mean_reversion_level);
+		decodeField(position, trade.vol_of_vol);
+		decodeField(position, trade.correlation);
+		decodeField(position, trade.rate);
+		decodeField(position, trade.maturity);
+		decodeField(position, trade.number_of_dates);
+		decodeField(position, contract);
+		decodeField(position, is_call);
+		decodeField(position, trade.strike);
+		decodeField(position, trade.parameter1);
+		decodeField(position, trade.parameter2);
+		trade.underlying.assign(underlying, strnlen(underlying, UNDERLYING_SIZE));
+		trade.contract = (ContractType)contract;
+		trade.is_call = (is_call != 0);
+
+		if (isValidTrade(trade))
+			return true;
+		std::cerr << "Record " << _record_number << ": invalid trade, skipped\n";
+	}
+	if (_file.gcount() > 0)
+		std::cerr << "Record " << _record_number + 1 << ": truncated, skipped\n";
+	return false;
+}
+
+TradeWriter::TradeWriter(const std::string& file_name) :
+	_file(file_name, std::ios::binary)
+{
+	_file.write(TradeReader::BINARY_MAGIC, 4);
+	writeField(_file, TradeReader::BINARY_VERSION);
+}
+
+bool TradeWriter::isOpen() const
+{
+	return _file.is_open();
+}
+
+void TradeWriter::write(const Trade& trade)
+{
+	char underlying[TradeReader::UNDERLYING_SIZE] = {};
+	// Padded with zeros, and truncated to UNDERLYING_SIZE bytes without terminating zero
+	std::memcpy(underlying, trade.underlying.data(), std::min(trade.underlying.size(), TradeReader::UNDERLYING_SIZE));
+	writeField(_file, trade.id);
+	_file.write(underlying, TradeReader::UNDERLYING_SIZE);
+	writeField(_file, trade.spot);
+	writeField(_file, trade.initial_variance);
+	writeField(_file, trade.mean_reversion_speed);
+	writeField(_file, trade.mean_reversion_level);
+	writeField(_file, trade.vol_of_vol);
+	writeField(_file, trade.correlation);
+	writeField(_file, trade.rate);
+	writeField(_file, trade.maturity);
+	writeField(_file, trade.number_of_dates);
+	writeField(_file, (uint8_t)trade.contract);
+	writeField(_file, (uint8_t)(trade.is_call ? 1 : 0));
+	writeField(_file, trade.strike);
+	writeField(_file, trade.parameter1);
+	writeField(_file, trade.parameter2);
+}
@@ -0,0 +1,92 @@
+#ifndef TRADEFILE_H
+#define TRADEFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+enum class ContractType : uint8_t
+{
+	VarianceSwap = 0,
+	VolatilitySwap = 1,
+	CappedVarianceSwap = 2,			// parameter1 is the cap
+	CorridorVarianceSwap = 3		// parameter1 and parameter2 are the lower and upper barriers
+};
+
+// One trade with the market parameters of its underlying (Heston model) and its schedule:
+// the realized variance is observed on number_of_dates equally spaced dates up to the maturity, after the date 0
+struct Trade
+{
+	uint64_t id;
+	std::string underlying;
+	double spot;
+	double initial_variance;
+	double mean_reversion_speed;
+	double mean_reversion_level;
+	double vol_of_vol;
+	double correlation;
+	double rate;
+	double maturity;
+	uint32_t number_of_dates;
+	ContractType contract;
+	bool is_call;
+	double strike;
+	double parameter1;
+	double parameter2;
+};
+
+// Longest schedule accepted, a daily schedule over more than 2700 years
+static const uint32_t MAXIMUM_NUMBER_OF_DATES = 1000000;
+
+// True if the trade can be priced: finite numbers, spot > 0, v0 >= 0, kappa, theta and sigma > 0, |rho| < 1, maturity > 0,
+// 0 < number_of_dates <= MAXIMUM_NUMBER_OF_DATES, a known contract, and lower < upper barrier for a corridor
+bool isValidTrade(const Trade& trade);
+
+// Trade from one line of the CSV format of TradeReader (without the end of line), false if the line is not a valid trade
+// (see isValidTrade)
+bool parseTrade(const std::string& line, Trade& trade);
+
+// Reads the trades of a file one at a time, so a file of any size is never loaded at once. Two formats:
+// - CSV, with a header line and the columns
+//   id,underlying,spot,initial_variance,kappa,theta,sigma,rho,rate,maturity,number_of_dates,contract,is_call,strike,parameter1,parameter2
+//   where contract is variance, volatility, capped or corridor, and is_call is 1 or 0;
+// - binary, a header (BINARY_MAGIC, BINARY_VERSION) followed by fixed size records with the same fields in the same order,
+//   the underlying on UNDERLYING_SIZE bytes (see TradeWriter).
+// The format is found from the first bytes of the file.
+class TradeReader final
+{
+public:
+	static const char BINARY_MAGIC[4];
+	static const uint32_t BINARY_VERSION = 1;
+	static const size_t UNDERLYING_SIZE = 16;
+
+	TradeReader(const std::string& file_name);
+
+	bool isOpen() const;
+	// Next valid trade, false at the end of the file. An invalid CSV line or binary record (see isValidTrade) is reported
+	// on std::cerr and skipped, as is a truncated last record.
+	bool next(Trade& trade);
+
+private:
+	bool nextCSV(Trade& trade);
+	bool nextBinary(Trade& trade);
+
+	std::ifstream _file;
+	bool _binary;
+	size_t _record_number;		// line of the CSV file, or record of the binary file
+};
+
+// Writes trades in the binary format of TradeReader
+class TradeWriter final
+{
+public:
+	TradeWriter(const std::string& file_name);
+
+	bool isOpen() const;
+	void write(const Trade& trade);
+
+private:
+	std::ofstream _file;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "WorkStealingPool.h"
+
+#include <exception>
+#include <iostream>
+
+WorkStealingPool::WorkStealingPool(size_t number_of_threads, size_t maximum_pending_tasks) :
+	_next_queue(0), _pending_tasks(0), _unfinished_tasks(0), _stopping(false)
+{
+	if (number_of_threads == 0)
+		number_of_threads = std::thread::hardware_concurrency();
+	if (number_of_threads == 0)
+		number_of_threads = 1;
+	_maximum_pending_tasks = (maximum_pending_tasks == 0) ? 4 * number_of_threads : maximum_pending_tasks;
+
+	_queues = std::vector<WorkerQueue>(number_of_threads);
+	_workers.reserve(number_of_threads);
+	for (size_t worker_index = 0; worker_index < number_of_threads; ++worker_index)
+		_workers.emplace_back(&WorkStealingPool::work, this, worker_index);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_task_available.notify_all();
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+size_t WorkStealingPool::getNumberOfThreads() const
+{
+	return _workers.size();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+	size_t queue_index;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_task_taken.wait(lock, [this] { return _pending_tasks < _maximum_pending_tasks; });
+		++_pending_tasks;
+		++_unfinished_tasks;
+		queue_index = _next_queue;
+		_next_queue = (_next_queue + 1) % _queues.size();
+	}
+	{
+		std::lock_guard<std::mutex> lock(_queues[queue_index].mutex);
+		_queues[queue_index].tasks.push_back(std::move(task));
+	}
+	_task_available.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_all_done.wait(lock, [this] { return _unfinished_tasks == 0; });
+}
+
+bool WorkStealingPool::popOrSteal(size_t worker_index, Task& task)
+{
+	// Own queue first, from the back
+	{
+		WorkerQueue& queue = _queues[worker_index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+	// Then the other queues, from the front
+	for (size_t offset = 1; offset < _queues.size(); ++offset)
+	{
+		WorkerQueue& queue = _queues[(worker_index + offset) % _queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::work(size_t worker_index)
+{
+	Task task;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_task_available.wait(lock, [this] { return _pending_tasks > 0 || _stopping; });
+			if (_pending_tasks == 0)
+				return;
+			// The task is reserved here, it is in one of the queues (pushed right after the counter was increased)
+			--_pending_tasks;
+		}
+		_task_taken.notify_one();
+
+		while (!popOrSteal(worker_index, task))
+			std::this_thread::yield();
+		// A task that throws is reported and counted as finished, the worker goes on
+		try {
+			task();
+		}
+		catch (const std::exception& exception) {
+			std::cerr << "WorkStealingPool: task failed: " << exception.what() << "\n";
+		}
+		catch (...) {
+			std::cerr << "WorkStealingPool: task failed\n";
+		}
+		task = nullptr;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_unfinished_tasks == 0)
+			_all_done.notify_all();
+	}
+}
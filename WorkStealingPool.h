@@ -0,0 +1,60 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of worker threads, each with its own queue of tasks. A worker runs the last task of its queue (the most recently
+// submitted, still warm in cache) and, when its queue is empty, steals the first task of the queue of another worker.
+// The number of tasks waiting in the queues is bounded: submit blocks while it is reached, so a producer reading
+// a large input never gets far ahead of the workers.
+// The tasks should handle their own errors: an exception escaping a task is only reported on std::cerr.
+class WorkStealingPool final
+{
+public:
+	using Task = std::function<void()>;
+
+	// 0 thread means one per core, 0 maximum pending tasks means 4 per thread
+	WorkStealingPool(size_t number_of_threads, size_t maximum_pending_tasks = 0);
+	// Copy is not possible (threads), the destructor waits for the submitted tasks and joins the workers
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+	~WorkStealingPool();
+
+	size_t getNumberOfThreads() const;
+	// Queues a task on the next worker, round robin
+	void submit(Task task);
+	// Blocks until every submitted task has run
+	void wait();
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void work(size_t worker_index);
+	bool popOrSteal(size_t worker_index, Task& task);
+
+	std::vector<WorkerQueue> _queues;
+	std::vector<std::thread> _workers;
+	size_t _maximum_pending_tasks;
+	size_t _next_queue;
+
+	// Counters of the tasks queued (pending) and not yet finished (unfinished), with the sleeping workers and producers
+	std::mutex _mutex;
+	std::condition_variable _task_available;
+	std::condition_variable _task_taken;
+	std::condition_variable _all_done;
+	size_t _pending_tasks;
+	size_t _unfinished_tasks;
+	bool _stopping;
+};
+
+#endif
@@ -0,0 +1,95 @@
+// Checks that the pricing loop does not allocate: the heap allocations of a pricing do not depend on the number of paths,
+// and the paths written in a caller buffer allocate nothing. Exits with 1 if not.
+// Separate executable, since operator new is replaced for the whole program: it is built from this file and every source
+// of the root of the repository but ProjetVarSwapPricing.cpp (which has the main of the pricer), the root being in the include path.
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "MonteCarloPricer2D.h"
+#include "Schema.h"
+
+// Heap allocations of the process
+static std::atomic<size_t> number_of_allocations(0);
+
+void* operator new(std::size_t size)
+{
+	++number_of_allocations;
+	if (void* pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+// GCC pairs the free below with the operator new above, not with the malloc inside it
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Same path simulator as the demo: Heston model, QE schema, daily grid over one year
+static PathSimulator2D create_path_simulator()
+{
+	Pair initial_factors(10., 0.04);
+	HestonModel model(0.5, 0., 0.5, 0.04, 1.);
+	size_t number_time_points = 365;
+	Vector time_points(number_time_points);
+	for (size_t time_index = 0; time_index < number_time_points; ++time_index)
+		time_points[time_index] = (double)time_index / (double)(number_time_points - 1);
+
+	schemaQE schema_QE(initial_factors, time_points, 1.5, model);
+	return PathSimulator2D(initial_factors, time_points, model, schema_QE);
+}
+
+int main()
+{
+	unsigned long long seed = 20240101;
+	PathSimulator2D path_simulator = create_path_simulator();
+	double strike = 0.04;
+	MonteCarloVarianceSwapPricer2D pricer_few_paths(path_simulator, 256, 0., strike, true);
+	MonteCarloVarianceSwapPricer2D pricer_many_paths(path_simulator, 64 * 256, 0., strike, true);
+
+	size_t allocations_before = number_of_allocations;
+	pricer_few_paths.price(1, seed);
+	size_t allocations_few_paths = number_of_allocations - allocations_before;
+
+	allocations_before = number_of_allocations;
+	pricer_many_paths.price(1, seed);
+	size_t allocations_many_paths = number_of_allocations - allocations_before;
+
+	PhiloxEngine engine(seed);
+	Vector_Pair buffer(path_simulator.getTimePoints().size());
+	allocations_before = number_of_allocations;
+	for (size_t path_index = 0; path_index < 256; ++path_index)
+		path_simulator.path(path_index, engine, buffer.data());
+	size_t allocations_buffer = number_of_allocations - allocations_before;
+
+	std::cout << "Heap allocations of a pricing: " << allocations_few_paths << " with 256 paths, " << allocations_many_paths
+		<< " with " << 64 * 256 << " paths\n";
+	std::cout << "Heap allocations of 256 paths in a caller buffer: " << allocations_buffer << "\n";
+
+	bool passed = true;
+	if (allocations_few_paths != allocations_many_paths) {
+		std::cerr << "FAILED: the pricing allocates in the path loop\n";
+		passed = false;
+	}
+	if (allocations_buffer != 0) {
+		std::cerr << "FAILED: the paths in a caller buffer allocate\n";
+		passed = false;
+	}
+	return passed ? 0 : 1;
+}